@@ -1,10 +1,10 @@
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <boost/bind.hpp>
 #include <boost/asio/ip/address.hpp>
 #include <boost/foreach.hpp>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
 
 #include "Client.hpp"
 #include "ChannelTemplate.hpp"
@@ -12,49 +12,41 @@
 #include "Notify.hpp"
 #include "Utils.hpp"
 
-CRedis::CRedis(boost::asio::io_service & ioservice, std::string password) :
-    m_ioservice(ioservice), m_pPub(nullptr), m_pSub(nullptr), m_password(password)
+CRedis::CRedis(boost::asio::io_service & ioservice, std::string password,
+    std::size_t publishers) :
+    m_ioservice(ioservice), m_password(password)
 {
-    m_pPub = new RedisAsyncClient(m_ioservice);
-    m_pSub = new RedisAsyncClient(m_ioservice);
+    for(std::size_t i = 0; i < std::max<std::size_t>(publishers, 1); i++)
+    {
+        m_pubs.push_back(CRedisLinkPtr(new CRedisLink(m_ioservice,
+            PUB_CONNECT_NAME "." + std::to_string(i))));
+    }
+
+    m_sub.reset(new CRedisLink(m_ioservice, SUB_CONNECT_NAME,
+        boost::bind(&CRedis::onSubConnect, this, _1)));
+
+    CRegistChannels SubChannels;
+    m_channels.insert(SubChannels.channels.begin(), SubChannels.channels.end());
 }
 
 CRedis::~CRedis()
 {
-    delete m_pPub;
-    delete m_pSub;
+    BOOST_FOREACH(CRedisLinkPtr &pub, m_pubs)
+    {
+        pub->disconnect();
+    }
+    m_sub->disconnect();
 }
 
 void CRedis::asyncConnect(const BOOSTADDR &address, 
     unsigned short port, const std::string pass)
 {
-    m_pPub->asyncConnect(address, port, [&](bool status, const std::string &err)
-    {
-        if(!status)
-        {
-            std::cerr << "Can't connect to redis for PUBLISH: " << err << std::endl;
-        }
-        else
-        {
-            std::cout << "Pub connect: " << err << std::endl;
-        }
-    });
-    
-    m_pSub->asyncConnect(address, port, [&](bool status, const std::string &err)
+    BOOST_FOREACH(CRedisLinkPtr &pub, m_pubs)
     {
-        if( !status )
-        {
-            std::cerr << "Can't connect to redis: " << err << std::endl;
-        }
-        else
-        {
-            std::cout << "Sub connect: " << err << std::endl;
-            /// Regist all channels
-            CRegistChannels SubChannels;
-            registChannels(SubChannels.channels);
-        }
-    });
+        pub->connect(address, port);
+    }
 
+    m_sub->connect(address, port);
 }
 
 void CRedis::connect()
@@ -71,79 +63,218 @@ void CRedis::connect(const std::string addr, unsigned short port)
 
 void CRedis::disconnect()
 {
-    m_pPub->disconnect();
-    
-    CRegistChannels SubChannels;
-    unregistChannels(SubChannels.channels);
-    m_pSub->disconnect();
+    BOOST_FOREACH(CRedisLinkPtr &pub, m_pubs)
+    {
+        pub->disconnect();
+    }
+
+    // Closing the subscriber drops its subscriptions; m_channels keeps
+    // them so the next connect subscribes them again.
+    m_sub->disconnect();
 }
 
-void CRedis::registChannels(const std::vector<std::string> &channels)
+void CRedis::onSubConnect(CRedisLink &)
 {
-    BOOST_FOREACH(std::string channel, channels)
+    std::set<std::string> channels;
+    std::set<std::string> patterns;
+    {
+        boost::mutex::scoped_lock lock(m_channelsMutex);
+        channels = m_channels;
+        patterns = m_patterns;
+    }
+
+    /// Regist all channels
+    BOOST_FOREACH(const std::string &channel, channels)
+    {
+        subscribe(channel);
+    }
+
+    BOOST_FOREACH(const std::string &pattern, patterns)
+    {
+        psubscribe(pattern);
+    }
+}
+
+void CRedis::subscribe(const std::string &channel)
+{
+    boost::shared_ptr<RedisAsyncClient> client = m_sub->client();
+
+    if(client && m_sub->isConnected())
     {
         std::cout << "Regist: " << channel << std::endl;
-        m_pSub->subscribe(channel, 
+        client->subscribeSlice(channel,
             boost::bind(&CRedis::onMessage, this, _1, _2),
             boost::bind(&CRedis::onSubAck, this, _1));
     }
 }
 
+void CRedis::registChannels(const std::vector<std::string> &channels)
+{
+    BOOST_FOREACH(std::string channel, channels)
+    {
+        registChannel(channel);
+    }
+}
+
 void CRedis::registChannel(const std::string channel)
 {
-    std::cout << "Regist: " << channel << std::endl;
-    m_pSub->subscribe(channel, 
-        boost::bind(&CRedis::onMessage, this, _1, _2),
-        boost::bind(&CRedis::onSubAck, this, _1));
+    {
+        boost::mutex::scoped_lock lock(m_channelsMutex);
+        if(!m_channels.insert(channel).second)
+        {
+            return;
+        }
+    }
+
+    // Otherwise subscribed once the subscriber connects
+    subscribe(channel);
 }
 
 void CRedis::unregistChannels(const std::vector<std::string> &channels)
 {
     BOOST_FOREACH(std::string channel, channels)
     {
-        std::cout << "UnRegist: " << channel << std::endl;
-        RedisAsyncClient::Handle handle = { 0 };
-        handle.channel = channel;
-        m_pSub->unsubscribe(handle);
+        unregistChannel(channel);
     }
 }
 
 void CRedis::unregistChannel(const std::string channel)
 {
     std::cout << "UnRegist: " << channel << std::endl;
-    RedisAsyncClient::Handle handle = { 0 };
-    handle.channel = channel;
-    m_pSub->unsubscribe(handle);
+    {
+        boost::mutex::scoped_lock lock(m_channelsMutex);
+        m_channels.erase(channel);
+    }
+
+    boost::shared_ptr<RedisAsyncClient> client = m_sub->client();
+
+    if(client && m_sub->isConnected())
+    {
+        RedisAsyncClient::Handle handle = { 0 };
+        handle.channel = channel;
+        client->unsubscribe(handle);
+    }
+}
+
+void CRedis::registPattern(const std::string pattern)
+{
+    {
+        boost::mutex::scoped_lock lock(m_channelsMutex);
+        if(!m_patterns.insert(pattern).second)
+        {
+            return;
+        }
+    }
+
+    // Otherwise subscribed once the subscriber connects
+    psubscribe(pattern);
+}
+
+void CRedis::unregistPattern(const std::string pattern)
+{
+    std::cout << "UnRegist pattern: " << pattern << std::endl;
+    {
+        boost::mutex::scoped_lock lock(m_channelsMutex);
+        m_patterns.erase(pattern);
+    }
+
+    boost::shared_ptr<RedisAsyncClient> client = m_sub->client();
+
+    if(client && m_sub->isConnected())
+    {
+        RedisAsyncClient::Handle handle = { 0 };
+        handle.channel = pattern;
+        client->punsubscribe(handle);
+    }
+}
+
+void CRedis::psubscribe(const std::string &pattern)
+{
+    boost::shared_ptr<RedisAsyncClient> client = m_sub->client();
+
+    if(client && m_sub->isConnected())
+    {
+        std::cout << "Regist pattern: " << pattern << std::endl;
+        client->psubscribeSlice(pattern,
+            boost::bind(&CRedis::onMessage, this, _1, _2),
+            boost::bind(&CRedis::onSubAck, this, _1));
+    }
+}
+
+CRedisLinkPtr CRedis::selectPublisher() const
+{
+    CRedisLinkPtr best;
+
+    BOOST_FOREACH(const CRedisLinkPtr &pub, m_pubs)
+    {
+        if(pub->isConnected() && (!best || pub->inFlight() < best->inFlight()))
+        {
+            best = pub;
+        }
+    }
+
+    return best;
+}
+
+std::vector<CRedisLinkStats> CRedis::statistics() const
+{
+    std::vector<CRedisLinkStats> stats;
+
+    BOOST_FOREACH(const CRedisLinkPtr &pub, m_pubs)
+    {
+        stats.push_back(pub->statistics());
+    }
+    stats.push_back(m_sub->statistics());
+
+    return stats;
 }
 
 void CRedis::AuthPub()
 {
-    // Auth
-    m_pPub->command(std::string("AUTH"), RedisBuffer(m_password), [&](const RedisValue &v) {
-        std::cerr << "Pub auth to server password(" << m_password << "): " << 
-            v.toString() << std::endl;
-        if(v.toString().compare("OK"))
+    BOOST_FOREACH(CRedisLinkPtr &pub, m_pubs)
+    {
+        boost::shared_ptr<RedisAsyncClient> client = pub->client();
+        std::string name = pub->name();
+
+        if(!client)
         {
-            // Set connection name
-            m_pPub->command(std::string("CLIENT"), RedisBuffer("SETNAME"), 
-                RedisBuffer(PUB_CONNECT_NAME), [&](const RedisValue &v) {
-                std::cerr << "Pub set connection name(" << PUB_CONNECT_NAME << "): " << 
-                    v.toString() << std::endl;
-            });
+            continue;
         }
-    });
+
+        // Auth
+        client->command(std::string("AUTH"), RedisBuffer(m_password), [=](const RedisValue &v) {
+            std::cerr << "Pub auth to server password(" << m_password << "): " << 
+                v.toString() << std::endl;
+            if(v.toString().compare("OK"))
+            {
+                // Set connection name
+                client->command(std::string("CLIENT"), RedisBuffer("SETNAME"), 
+                    RedisBuffer(name), [=](const RedisValue &v) {
+                    std::cerr << "Pub set connection name(" << name << "): " << 
+                        v.toString() << std::endl;
+                });
+            }
+        });
+    }
 }
 
 void CRedis::AuthSub()
 {
+    boost::shared_ptr<RedisAsyncClient> client = m_sub->client();
+
+    if(!client)
+    {
+        return;
+    }
+
     // Set connection name
-    m_pSub->command(std::string("CLIENT"), RedisBuffer("SETNAME"), 
+    client->command(std::string("CLIENT"), RedisBuffer("SETNAME"), 
         RedisBuffer(SUB_CONNECT_NAME), [&](const RedisValue &v) {
         std::cerr << "Sub set connection name(" << SUB_CONNECT_NAME << "): " 
                   << v.toString() << std::endl;
     });
     // Auth
-    m_pSub->command(std::string("AUTH"), RedisBuffer(m_password), [&](const RedisValue &v) {
+    client->command(std::string("AUTH"), RedisBuffer(m_password), [&](const RedisValue &v) {
         std::cerr << "Sub auth to server password(" << m_password << "): " 
                   << v.toString() << std::endl;
     });
@@ -151,9 +282,11 @@ void CRedis::AuthSub()
 
 void CRedis::pushMessage(const std::string &channel, const std::string &message)
 {
-    if(m_pPub->isConnected())
+    CRedisLinkPtr pub = selectPublisher();
+
+    if(pub)
     {
-        m_pPub->publish(channel, message, [&](const RedisValue &) {});
+        pub->publish(channel, message);
     }
     else
     {
@@ -162,9 +295,9 @@ void CRedis::pushMessage(const std::string &channel, const std::string &message)
 }
 
 // Receive subscribed channel message
-void CRedis::onMessage(const std::vector<char> &buf, const std::string channel)
+void CRedis::onMessage(const RedisSlice &payload, const std::string &channel)
 {
-    std::string msg(buf.begin(), buf.end());
+    std::string msg = payload.toString();
 
     std::cerr << "[" << channel << "]Message: " << msg << std::endl;
 
@@ -185,18 +318,33 @@ void CRedis::onMessage(const std::vector<char> &buf, const std::string channel)
     }
     else if(channel == "TEST")
     {
-        std::vector<std::string> cmd;
-        boost::split(cmd, msg, boost::is_any_of(" "), boost::token_compress_on);
-        std::list<RedisBuffer> args;
-        for(unsigned int c = 1; c < cmd.size(); c++)
+        // Arguments are slices of the payload itself: they share its
+        // buffer, so nothing is copied and nothing can dangle.
+        std::vector<RedisSlice> args;
+        std::size_t pos = 0;
+        while(pos < payload.size())
         {
-            args.push_back(cmd[c]);
+            const char *begin = payload.data() + pos;
+            const char *space = static_cast<const char *>(
+                memchr(begin, ' ', payload.size() - pos));
+            std::size_t len = space ? space - begin : payload.size() - pos;
+            if(len > 0)
+            {
+                args.push_back(payload.sub(pos, len));
+            }
+            pos += len + 1;
         }
-        if(cmd[0] == "LRANGE")
-            m_pPub->command(cmd[0], args, boost::bind(&CRedis::onList, this, _1));
+        if(args.empty())
+            return;
+        std::string cmd = args[0].toString();
+        args.erase(args.begin());
+        CRedisLinkPtr pub = selectPublisher();
+        if(!pub)
+            return;
+        if(cmd == "LRANGE")
+            pub->command(cmd, args, boost::bind(&CRedis::onList, this, _1));
         else
-            m_pPub->command(cmd[0], args, boost::bind(&CRedis::onCommonAck, this, _1));
-            
+            pub->command(cmd, args, boost::bind(&CRedis::onCommonAck, this, _1));
     }
 }
 
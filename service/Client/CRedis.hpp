@@ -1,5 +1,6 @@
 #include <string>
 #include <iostream>
+#include <set>
 #include <vector>
 
 #include <boost/bind.hpp>
@@ -9,24 +10,29 @@
 #include <boost/shared_ptr.hpp>
 
 #include "redisasyncclient.h"
+#include "CRedisLink.hpp"
 
 #define PUB_CONNECT_NAME "service.system.publisher"
 #define SUB_CONNECT_NAME "service.system.subscriber"
 
+// Publisher connections opened by default
+#define PUB_POOL_SIZE 4
+
 typedef boost::asio::ip::address BOOSTADDR;
 
 class CRedis
 {
 public:
-    explicit CRedis(boost::asio::io_service & ioservice, std::string password);
-    
+    explicit CRedis(boost::asio::io_service & ioservice, std::string password,
+        std::size_t publishers = PUB_POOL_SIZE);
+
     ~CRedis();
 
     // Default redis server
     void connect();
-    
+
     void connect(const std::string addr, unsigned short port);
-    
+
     void disconnect();
 
     void pushMessage(const std::string &channel, const std::string &message);
@@ -38,16 +44,35 @@ public:
     void unregistChannels(const std::vector<std::string> &channels);
 
     void unregistChannel(const std::string channel);
-    
+
+    // Glob-style pattern such as "HM.DEVICE.*", so one subscription covers
+    // any number of per-device channels.
+    void registPattern(const std::string pattern);
+
+    void unregistPattern(const std::string pattern);
+
+    // Per-connection counters, publishers first, subscriber last.
+    std::vector<CRedisLinkStats> statistics() const;
+
 protected:
 
-    void asyncConnect(const BOOSTADDR &address, unsigned short port, 
+    void asyncConnect(const BOOSTADDR &address, unsigned short port,
         const std::string pass = "admin");
 
-    void onMessage(const std::vector<char> &buf, const std::string channel);
-    
+    void onMessage(const RedisSlice &payload, const std::string &channel);
+
     void onSubAck(const RedisValue &value);
 
+    // Subscribe link (re)connected: subscribe every registered channel again.
+    void onSubConnect(CRedisLink &link);
+
+    // Connected publisher with the fewest outstanding commands, or null.
+    CRedisLinkPtr selectPublisher() const;
+
+    void subscribe(const std::string &channel);
+
+    void psubscribe(const std::string &pattern);
+
     void AuthPub();
 
     void AuthSub();
@@ -60,10 +85,14 @@ private:
 
     boost::asio::io_service &m_ioservice;
 
-    RedisAsyncClient *m_pPub;
-    
-    RedisAsyncClient *m_pSub;
+    std::vector<CRedisLinkPtr> m_pubs;
+
+    CRedisLinkPtr m_sub;
+
+    // Channels to subscribe on every connect of the subscriber.
+    boost::mutex m_channelsMutex;
+    std::set<std::string> m_channels;
+    std::set<std::string> m_patterns;
 
     std::string m_password;
 };
-
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <iostream>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "CRedisLink.hpp"
+
+CRedisLink::CRedisLink(boost::asio::io_service &ioservice, const std::string &name,
+    const ConnectHandler &onConnect) :
+    m_ioservice(ioservice), m_timer(ioservice), m_name(name), m_onConnect(onConnect),
+    m_generation(0), m_backoff(BACKOFF_MIN_MS), m_stopped(false),
+    m_connected(false), m_inflight(0), m_reconnects(0)
+{
+    for(unsigned int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        m_latency[i] = 0;
+    }
+}
+
+CRedisLink::~CRedisLink()
+{
+    if(m_retired)
+    {
+        m_ioservice.post(boost::bind(&CRedisLink::releaseClient, m_retired));
+    }
+}
+
+void CRedisLink::connect(const boost::asio::ip::address &address, unsigned short port)
+{
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        m_endpoint = boost::asio::ip::tcp::endpoint(address, port);
+        m_stopped = false;
+    }
+
+    startConnect();
+}
+
+void CRedisLink::disconnect()
+{
+    boost::shared_ptr<RedisAsyncClient> client;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        m_stopped = true;
+        ++m_generation;
+        client = m_client;
+        m_client.reset();
+    }
+
+    boost::system::error_code ignored_ec;
+    m_timer.cancel(ignored_ec);
+    m_connected = false;
+
+    if(client)
+    {
+        client->disconnect();
+        m_ioservice.post(boost::bind(&CRedisLink::releaseClient, client));
+    }
+}
+
+boost::shared_ptr<RedisAsyncClient> CRedisLink::client() const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_client;
+}
+
+void CRedisLink::startConnect()
+{
+    boost::shared_ptr<RedisAsyncClient> client(new RedisAsyncClient(m_ioservice));
+    unsigned int generation;
+    boost::asio::ip::tcp::endpoint endpoint;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        generation = ++m_generation;
+        m_client = client;
+        endpoint = m_endpoint;
+    }
+
+    boost::weak_ptr<CRedisLink> self(shared_from_this());
+
+    client->installErrorHandler(boost::bind(&CRedisLink::errorThunk,
+        self, generation, _1));
+    client->connect(endpoint, boost::bind(&CRedisLink::connectedThunk,
+        self, generation, _1, _2));
+}
+
+void CRedisLink::connectedThunk(const boost::weak_ptr<CRedisLink> &link,
+    unsigned int generation, bool status, const std::string &err)
+{
+    CRedisLinkPtr self = link.lock();
+
+    if(self)
+    {
+        self->onConnected(generation, status, err);
+    }
+}
+
+void CRedisLink::errorThunk(const boost::weak_ptr<CRedisLink> &link,
+    unsigned int generation, const std::string &err)
+{
+    CRedisLinkPtr self = link.lock();
+
+    if(self)
+    {
+        self->onError(generation, err);
+    }
+}
+
+void CRedisLink::releaseClient(const boost::shared_ptr<RedisAsyncClient> &)
+{
+}
+
+void CRedisLink::onConnected(unsigned int generation, bool status, const std::string &err)
+{
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        if(generation != m_generation || m_stopped)
+        {
+            return;
+        }
+        if(status)
+        {
+            m_backoff = BACKOFF_MIN_MS;
+        }
+    }
+
+    if(!status)
+    {
+        std::cerr << "[" << m_name << "] Can't connect to redis: " << err << std::endl;
+        scheduleReconnect();
+        return;
+    }
+
+    std::cout << "[" << m_name << "] connect: " << err << std::endl;
+    m_connected = true;
+
+    if(m_onConnect)
+    {
+        m_onConnect(*this);
+    }
+}
+
+void CRedisLink::onError(unsigned int generation, const std::string &err)
+{
+    boost::shared_ptr<RedisAsyncClient> client;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        if(generation != m_generation || m_stopped)
+        {
+            return;
+        }
+        // Later errors from this client belong to a dead generation
+        ++m_generation;
+        client = m_client;
+        m_retired = m_client;
+    }
+
+    std::cerr << "[" << m_name << "] Redis connection lost: " << err << std::endl;
+    m_connected = false;
+
+    if(client)
+    {
+        client->disconnect();
+    }
+
+    scheduleReconnect();
+}
+
+void CRedisLink::scheduleReconnect()
+{
+    long delay;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        delay = m_backoff;
+        m_backoff = std::min<long>(m_backoff * 2, BACKOFF_MAX_MS);
+    }
+
+    m_timer.expires_from_now(boost::posix_time::milliseconds(delay));
+    m_timer.async_wait(boost::bind(&CRedisLink::onReconnectTimer,
+        shared_from_this(), boost::asio::placeholders::error));
+}
+
+void CRedisLink::onReconnectTimer(const boost::system::error_code &ec)
+{
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        if(ec || m_stopped)
+        {
+            return;
+        }
+        m_retired.reset();
+    }
+
+    ++m_reconnects;
+    startConnect();
+}
+
+CRedisLink::ReplyHandler CRedisLink::track(const ReplyHandler &handler)
+{
+    m_inflight.fetch_add(1, std::memory_order_relaxed);
+
+    return boost::bind(&CRedisLink::onReply, shared_from_this(),
+        boost::posix_time::microsec_clock::universal_time(), handler, _1);
+}
+
+void CRedisLink::onReply(boost::posix_time::ptime start, const ReplyHandler &handler,
+    const RedisValue &value)
+{
+    boost::posix_time::time_duration elapsed =
+        boost::posix_time::microsec_clock::universal_time() - start;
+    long long us = elapsed.total_microseconds();
+
+    unsigned int bucket = 0;
+    while(bucket < LATENCY_BUCKETS - 1 && us >= (1LL << bucket))
+    {
+        bucket++;
+    }
+
+    m_latency[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_inflight.fetch_sub(1, std::memory_order_relaxed);
+
+    handler(value);
+}
+
+void CRedisLink::publish(const std::string &channel, const std::string &message,
+    const ReplyHandler &handler)
+{
+    boost::shared_ptr<RedisAsyncClient> client = this->client();
+
+    if(client && isConnected())
+    {
+        client->publish(channel, message, track(handler));
+    }
+    else
+    {
+        notConnected(handler);
+    }
+}
+
+void CRedisLink::command(const std::string &cmd, const std::vector<RedisSlice> &args,
+    const ReplyHandler &handler)
+{
+    boost::shared_ptr<RedisAsyncClient> client = this->client();
+
+    if(client && isConnected())
+    {
+        client->command(cmd, args, track(handler));
+    }
+    else
+    {
+        notConnected(handler);
+    }
+}
+
+void CRedisLink::notConnected(const ReplyHandler &handler)
+{
+    // Replies never arrive from inside the call; keep it that way
+    m_ioservice.post(boost::bind(handler,
+        RedisClientImpl::errorValue("ERR not connected")));
+}
+
+CRedisLinkStats CRedisLink::statistics() const
+{
+    CRedisLinkStats stats;
+
+    stats.name = m_name;
+    stats.connected = isConnected();
+    stats.inFlight = inFlight();
+    stats.reconnects = m_reconnects.load(std::memory_order_relaxed);
+    stats.latency.resize(LATENCY_BUCKETS);
+
+    for(unsigned int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        stats.latency[i] = m_latency[i].load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
@@ -0,0 +1,133 @@
+#ifndef CREDIS_LINK_HPP
+#define CREDIS_LINK_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include "redisasyncclient.h"
+
+// Counters of one redis connection, see CRedisLink::statistics().
+struct CRedisLinkStats
+{
+    std::string name;
+    bool connected;
+    long inFlight;                      // Commands sent, reply not yet received
+    unsigned long reconnects;
+    // latency[i] counts replies that took less than 2^i microseconds,
+    // the last bucket everything slower.
+    std::vector<unsigned long> latency;
+};
+
+// One redis connection that reconnects itself with exponential backoff
+// and tracks outstanding commands and reply latency. Must be owned by a
+// boost::shared_ptr (CRedisLinkPtr).
+class CRedisLink : public boost::enable_shared_from_this<CRedisLink>,
+    private boost::noncopyable
+{
+public:
+    typedef boost::function<void(const RedisValue &)> ReplyHandler;
+    typedef boost::function<void(CRedisLink &)> ConnectHandler;
+
+    enum
+    {
+        LATENCY_BUCKETS = 24,           // Up to ~8 s
+        BACKOFF_MIN_MS = 100,
+        BACKOFF_MAX_MS = 30000
+    };
+
+    // onConnect runs after every successful (re)connect.
+    CRedisLink(boost::asio::io_service &ioservice, const std::string &name,
+        const ConnectHandler &onConnect = ConnectHandler());
+
+    ~CRedisLink();
+
+    void connect(const boost::asio::ip::address &address, unsigned short port);
+
+    // Close the connection and stop reconnecting.
+    void disconnect();
+
+    bool isConnected() const { return m_connected.load(); }
+
+    long inFlight() const { return m_inflight.load(std::memory_order_relaxed); }
+
+    const std::string &name() const { return m_name; }
+
+    // Current client; replaced on reconnect. Commands issued directly on
+    // it are not counted.
+    boost::shared_ptr<RedisAsyncClient> client() const;
+
+    void publish(const std::string &channel, const std::string &message,
+        const ReplyHandler &handler = &RedisAsyncClient::dummyHandler);
+
+    void command(const std::string &cmd, const std::vector<RedisSlice> &args,
+        const ReplyHandler &handler = &RedisAsyncClient::dummyHandler);
+
+    CRedisLinkStats statistics() const;
+
+private:
+    void startConnect();
+
+    void onConnected(unsigned int generation, bool status, const std::string &err);
+
+    void onError(unsigned int generation, const std::string &err);
+
+    // The client is owned by the link, so the handlers installed on it
+    // hold the link weakly and forward only while it is still alive.
+    static void connectedThunk(const boost::weak_ptr<CRedisLink> &link,
+        unsigned int generation, bool status, const std::string &err);
+
+    static void errorThunk(const boost::weak_ptr<CRedisLink> &link,
+        unsigned int generation, const std::string &err);
+
+    // Posted with a closed client; the client is destroyed once the
+    // aborted operations queued ahead of it have run.
+    static void releaseClient(const boost::shared_ptr<RedisAsyncClient> &client);
+
+    void scheduleReconnect();
+
+    void onReconnectTimer(const boost::system::error_code &ec);
+
+    void onReply(boost::posix_time::ptime start, const ReplyHandler &handler,
+        const RedisValue &value);
+
+    ReplyHandler track(const ReplyHandler &handler);
+
+    // Fail a command issued while the link is down.
+    void notConnected(const ReplyHandler &handler);
+
+    boost::asio::io_service &m_ioservice;
+    boost::asio::deadline_timer m_timer;
+    std::string m_name;
+    ConnectHandler m_onConnect;
+
+    boost::asio::ip::tcp::endpoint m_endpoint;
+
+    mutable boost::mutex m_mutex;
+    boost::shared_ptr<RedisAsyncClient> m_client;
+    // Client that failed; kept until the next attempt so its aborted
+    // operations complete before it is destroyed.
+    boost::shared_ptr<RedisAsyncClient> m_retired;
+    unsigned int m_generation;
+    long m_backoff;                     // Milliseconds
+    bool m_stopped;
+
+    std::atomic<bool> m_connected;
+    std::atomic<long> m_inflight;
+    std::atomic<unsigned long> m_reconnects;
+    std::atomic<unsigned long> m_latency[LATENCY_BUCKETS];
+};
+
+typedef boost::shared_ptr<CRedisLink> CRedisLinkPtr;
+
+#endif /* CREDIS_LINK_HPP */
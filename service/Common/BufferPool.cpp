@@ -0,0 +1,185 @@
+
+#include <new>
+
+#include "BufferPool.hpp"
+
+namespace service {
+
+/// Per-thread stash of released blocks, one LIFO list per size class.
+struct thread_cache
+{
+    detail::pool_block *heads[buffer_pool::CLASS_COUNT];
+    unsigned int counts[buffer_pool::CLASS_COUNT];
+
+    thread_cache()
+    {
+        for (unsigned int i = 0; i < buffer_pool::CLASS_COUNT; ++i)
+        {
+            heads[i] = 0;
+            counts[i] = 0;
+        }
+    }
+
+    ~thread_cache();
+};
+
+static thread_local thread_cache t_cache;
+
+// Set once t_cache is destroyed: buffers released later during thread exit
+// go straight to the shared lists.
+static thread_local bool t_cache_gone = false;
+
+thread_cache::~thread_cache()
+{
+    t_cache_gone = true;
+    buffer_pool::instance().drain(heads);
+}
+
+buffer_pool &buffer_pool::instance()
+{
+    // Never destroyed: handles may outlive static destruction order.
+    static buffer_pool *pool = new buffer_pool();
+    return *pool;
+}
+
+buffer_pool::buffer_pool()
+    : m_hits(0), m_misses(0), m_in_use(0), m_high_water(0)
+{
+    for (unsigned int i = 0; i < CLASS_COUNT; ++i)
+    {
+        m_free[i] = 0;
+        m_free_count[i] = 0;
+    }
+}
+
+unsigned int buffer_pool::size_class(std::size_t size)
+{
+    unsigned int cls = 0;
+    while (cls < CLASS_COUNT && class_size(cls) < size)
+        ++cls;
+    return cls;
+}
+
+pooled_buffer buffer_pool::allocate(std::size_t size)
+{
+    unsigned int cls = size_class(size);
+    detail::pool_block *block = 0;
+
+    if (cls < CLASS_COUNT)
+    {
+        if (!t_cache_gone && t_cache.heads[cls])
+        {
+            thread_cache &cache = t_cache;
+            block = cache.heads[cls];
+            cache.heads[cls] = block->next;
+            --cache.counts[cls];
+        }
+        else
+        {
+            boost::mutex::scoped_lock lock(m_mutex[cls]);
+            if (m_free[cls])
+            {
+                block = m_free[cls];
+                m_free[cls] = block->next;
+                --m_free_count[cls];
+            }
+        }
+    }
+
+    std::size_t capacity = cls < CLASS_COUNT ? class_size(cls) : size;
+
+    if (block)
+    {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        void *mem = ::operator new(pooled_buffer::header_size + capacity);
+        block = static_cast<detail::pool_block *>(mem);
+        new (&block->refs) std::atomic<long>(0);
+        block->cls = cls;
+    }
+
+    block->refs.store(1, std::memory_order_relaxed);
+    block->size = size;
+    block->next = 0;
+
+    std::size_t in_use = m_in_use.fetch_add(capacity, std::memory_order_relaxed) + capacity;
+    std::size_t peak = m_high_water.load(std::memory_order_relaxed);
+    while (in_use > peak &&
+        !m_high_water.compare_exchange_weak(peak, in_use, std::memory_order_relaxed))
+    {
+    }
+
+    return pooled_buffer(block);
+}
+
+void buffer_pool::release(detail::pool_block *block)
+{
+    unsigned int cls = block->cls;
+
+    if (cls >= CLASS_COUNT)
+    {
+        m_in_use.fetch_sub(block->size, std::memory_order_relaxed);
+        ::operator delete(block);
+        return;
+    }
+
+    m_in_use.fetch_sub(class_size(cls), std::memory_order_relaxed);
+
+    if (!t_cache_gone)
+    {
+        thread_cache &cache = t_cache;
+        if (cache.counts[cls] < THREAD_CACHE_DEPTH)
+        {
+            block->next = cache.heads[cls];
+            cache.heads[cls] = block;
+            ++cache.counts[cls];
+            return;
+        }
+    }
+
+    release_shared(block);
+}
+
+void buffer_pool::release_shared(detail::pool_block *block)
+{
+    unsigned int cls = block->cls;
+    {
+        boost::mutex::scoped_lock lock(m_mutex[cls]);
+        if (m_free_count[cls] < SHARED_CLASS_BYTES / class_size(cls))
+        {
+            block->next = m_free[cls];
+            m_free[cls] = block;
+            ++m_free_count[cls];
+            return;
+        }
+    }
+    ::operator delete(block);
+}
+
+void buffer_pool::drain(detail::pool_block **heads)
+{
+    for (unsigned int cls = 0; cls < CLASS_COUNT; ++cls)
+    {
+        while (heads[cls])
+        {
+            detail::pool_block *block = heads[cls];
+            heads[cls] = block->next;
+            release_shared(block);
+        }
+    }
+}
+
+buffer_pool::stats buffer_pool::statistics() const
+{
+    stats s;
+    s.hits = m_hits.load(std::memory_order_relaxed);
+    s.misses = m_misses.load(std::memory_order_relaxed);
+    s.in_use = m_in_use.load(std::memory_order_relaxed);
+    s.high_water = m_high_water.load(std::memory_order_relaxed);
+    return s;
+}
+
+} // service
@@ -0,0 +1,164 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace service {
+
+class buffer_pool;
+
+namespace detail {
+
+/// Header placed in front of every pooled allocation.
+struct pool_block
+{
+    std::atomic<long> refs;
+    std::size_t size;       /* Requested bytes */
+    unsigned int cls;       /* Size class, or buffer_pool::CLASS_COUNT if unpooled */
+    pool_block *next;       /* Free list link */
+};
+
+} // detail
+
+/// Refcounted handle on a block from buffer_pool. Copies share the block;
+/// the last handle to go returns it to the pool.
+class pooled_buffer
+{
+public:
+    pooled_buffer() : m_block(0) {}
+
+    pooled_buffer(const pooled_buffer &o) : m_block(o.m_block)
+    {
+        if (m_block)
+            m_block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    pooled_buffer(pooled_buffer &&o) : m_block(o.m_block)
+    {
+        o.m_block = 0;
+    }
+
+    pooled_buffer &operator=(const pooled_buffer &o)
+    {
+        pooled_buffer tmp(o);
+        std::swap(m_block, tmp.m_block);
+        return *this;
+    }
+
+    pooled_buffer &operator=(pooled_buffer &&o)
+    {
+        std::swap(m_block, o.m_block);
+        o.reset();
+        return *this;
+    }
+
+    ~pooled_buffer() { reset(); }
+
+    /// Drop this reference.
+    void reset();
+
+    char *data() { return m_block ? payload(m_block) : 0; }
+    const char *data() const { return m_block ? payload(m_block) : 0; }
+
+    std::size_t size() const { return m_block ? m_block->size : 0; }
+
+    bool empty() const { return size() == 0; }
+
+    long use_count() const
+    {
+        return m_block ? m_block->refs.load(std::memory_order_relaxed) : 0;
+    }
+
+    /// Offset of the payload from the block header.
+    static const std::size_t header_size =
+        (sizeof(detail::pool_block) + 15) & ~static_cast<std::size_t>(15);
+
+private:
+    friend class buffer_pool;
+
+    explicit pooled_buffer(detail::pool_block *block) : m_block(block) {}
+
+    static char *payload(detail::pool_block *block)
+    {
+        return reinterpret_cast<char *>(block) + header_size;
+    }
+
+    detail::pool_block *m_block;
+};
+
+/// Process-wide size-classed buffer pool. Each thread keeps a small cache
+/// per class so the common allocate/release path takes no lock; overflow
+/// goes to a mutex-protected shared free list per class, which holds at
+/// most SHARED_CLASS_BYTES so a burst does not pin its peak forever.
+class buffer_pool : private boost::noncopyable
+{
+public:
+    enum
+    {
+        MIN_CLASS_SHIFT = 6,        /* Smallest class holds 64 bytes */
+        CLASS_COUNT = 15,           /* Largest class holds 1 MB */
+        THREAD_CACHE_DEPTH = 32,    /* Blocks cached per class per thread */
+        SHARED_CLASS_BYTES = 4 << 20 /* Free bytes kept per class beyond that */
+    };
+
+    struct stats
+    {
+        unsigned long hits;         /* Served from a free list */
+        unsigned long misses;       /* Fresh heap allocation */
+        std::size_t in_use;         /* Bytes currently handed out */
+        std::size_t high_water;     /* Peak of in_use */
+    };
+
+    static buffer_pool &instance();
+
+    /// Get a buffer of exactly size bytes.
+    pooled_buffer allocate(std::size_t size);
+
+    /// Snapshot of the counters.
+    stats statistics() const;
+
+private:
+    friend class pooled_buffer;
+    friend struct thread_cache;
+
+    buffer_pool();
+
+    void release(detail::pool_block *block);
+
+    /// Return a thread's cached blocks to the shared lists.
+    void drain(detail::pool_block **heads);
+
+    /// Put a free block on its shared list, or free it if the list is full.
+    void release_shared(detail::pool_block *block);
+
+    static unsigned int size_class(std::size_t size);
+
+    static std::size_t class_size(unsigned int cls)
+    {
+        return static_cast<std::size_t>(1) << (cls + MIN_CLASS_SHIFT);
+    }
+
+    boost::mutex m_mutex[CLASS_COUNT];
+    detail::pool_block *m_free[CLASS_COUNT];
+    std::size_t m_free_count[CLASS_COUNT];
+
+    std::atomic<unsigned long> m_hits;
+    std::atomic<unsigned long> m_misses;
+    std::atomic<std::size_t> m_in_use;
+    std::atomic<std::size_t> m_high_water;
+};
+
+inline void pooled_buffer::reset()
+{
+    if (m_block && m_block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        buffer_pool::instance().release(m_block);
+    m_block = 0;
+}
+
+} // service
+
+#endif /* BUFFER_POOL_HPP */
@@ -0,0 +1,100 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include <boost/array.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace service {
+
+/// Fixed-capacity byte ring used as a per-connection receive buffer.
+/// The socket reads straight into the free space (at most two segments),
+/// and the framer consumes from the front without moving the data.
+class ring_buffer : private boost::noncopyable
+{
+public:
+    typedef boost::array<boost::asio::mutable_buffer, 2> mutable_buffers_type;
+
+    /// Capacity is rounded up to a power of two.
+    explicit ring_buffer(std::size_t capacity)
+        : m_mask(round_up(capacity) - 1),
+          m_data(m_mask + 1),
+          m_head(0),
+          m_tail(0)
+    {
+    }
+
+    std::size_t capacity() const { return m_mask + 1; }
+
+    /// Number of readable bytes.
+    std::size_t size() const { return m_tail - m_head; }
+
+    bool empty() const { return m_head == m_tail; }
+
+    bool full() const { return size() == capacity(); }
+
+    /// Free space as up to two buffers suitable for async_read_some.
+    mutable_buffers_type prepare()
+    {
+        std::size_t free_size = capacity() - size();
+        std::size_t pos = m_tail & m_mask;
+        std::size_t first = std::min(free_size, capacity() - pos);
+
+        mutable_buffers_type bufs;
+        bufs[0] = boost::asio::buffer(&m_data[0] + pos, first);
+        bufs[1] = boost::asio::buffer(&m_data[0], free_size - first);
+        return bufs;
+    }
+
+    /// Make n bytes written through prepare() readable.
+    void commit(std::size_t n) { m_tail += n; }
+
+    /// Drop n bytes from the front.
+    void consume(std::size_t n)
+    {
+        m_head += n;
+        if (m_head == m_tail)
+            m_head = m_tail = 0;
+    }
+
+    /// Length of the readable run starting at the front before it wraps.
+    std::size_t contiguous() const
+    {
+        return std::min(size(), capacity() - (m_head & m_mask));
+    }
+
+    /// Pointer to the front of the readable data, valid for contiguous() bytes.
+    const char *data() const { return &m_data[0] + (m_head & m_mask); }
+    char *data() { return &m_data[0] + (m_head & m_mask); }
+
+    /// Copy n bytes from the front without consuming them.
+    void peek(void *dst, std::size_t n) const
+    {
+        std::size_t first = std::min(n, contiguous());
+        std::memcpy(dst, data(), first);
+        if (first < n)
+            std::memcpy(static_cast<char *>(dst) + first, &m_data[0], n - first);
+    }
+
+private:
+    static std::size_t round_up(std::size_t n)
+    {
+        std::size_t v = 1;
+        while (v < n)
+            v <<= 1;
+        return v;
+    }
+
+    std::size_t m_mask;
+    std::vector<char> m_data;
+    /// Monotonic read/write positions, masked on access.
+    std::size_t m_head;
+    std::size_t m_tail;
+};
+
+} // service
+
+#endif /* RING_BUFFER_HPP */
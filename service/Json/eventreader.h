@@ -0,0 +1,166 @@
+// Copyright 2007-2010 Baptiste Lepilleur
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef CPPTL_JSON_EVENTREADER_H_INCLUDED
+#define CPPTL_JSON_EVENTREADER_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "value.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <string>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace Json {
+
+/** \brief Receives the events of an EventReader.
+ *
+ * Each callback returns \c true to continue or \c false to stop parsing,
+ * e.g. once the members of interest have been seen. The default
+ * implementations ignore the event.
+ *
+ * Keys and strings are UTF-8 with escapes decoded; [begin, end) is only
+ * valid during the call and may contain '\\0'. Numbers are passed as an
+ * #intValue, #uintValue or #realValue Value, decoded as Reader would.
+ */
+class JSON_API EventHandler {
+public:
+  virtual ~EventHandler();
+
+  virtual bool startObject();
+  virtual bool endObject();
+  virtual bool startArray();
+  virtual bool endArray();
+  virtual bool key(const char* begin, const char* end);
+  virtual bool string(const char* begin, const char* end);
+  virtual bool number(const Value& value);
+  virtual bool boolean(bool value);
+  virtual bool null();
+};
+
+/** \brief Incremental <a HREF="http://www.json.org">JSON</a> parser that
+ * reports events to an EventHandler instead of building a Value.
+ *
+ * The document may be fed in chunks of any size, as it arrives. A token
+ * split across chunks is buffered until it is complete; other tokens are
+ * reported straight from the chunk. Memory use is bounded by the longest
+ * string and the nesting depth, whatever the size of the document.
+ *
+ * Input must be strict JSON (one value, no comments).
+ *
+ * Usage:
+ * \code
+ * Json::EventReader reader(handler);
+ * while (reader.feed(chunk, chunk + size) && !reader.complete())
+ *   ; // read the next chunk
+ * if (!reader.finish() && !reader.good())
+ *   std::cerr << reader.getFormattedErrorMessages();
+ * \endcode
+ */
+class JSON_API EventReader {
+public:
+  /// \param stackLimit Deepest nesting of arrays and objects accepted.
+  explicit EventReader(EventHandler& handler, unsigned stackLimit = 1000);
+
+  /** \brief Parse the next chunk of the document.
+   * \return \c false if the document is invalid or the handler stopped
+   * parsing; later calls then do nothing.
+   */
+  bool feed(const char* begin, const char* end);
+
+  /** \brief Signal the end of the document.
+   * Completes a number at the end of the input.
+   * \return \c true if a whole value was read.
+   */
+  bool finish();
+
+  /// Parse a whole document: feed() then finish().
+  bool parse(const char* begin, const char* end);
+
+  /// Forget the current document to parse another one.
+  void reset();
+
+  /// \c true once the root value has been read.
+  bool complete() const;
+
+  /// \c true if a callback returned \c false.
+  bool stopped() const;
+
+  /// \c false if the document is invalid.
+  bool good() const;
+
+  /// Bytes of the document consumed so far.
+  size_t offset() const;
+
+  /// Empty if good(), otherwise where and why parsing failed.
+  JSONCPP_STRING getFormattedErrorMessages() const;
+
+private:
+  enum Status { statusParsing, statusStopped, statusFailed };
+
+  // What may come next, outside of a token
+  enum State {
+    stateValue,       // a value
+    stateArrayFirst,  // a value or ']'
+    stateObjectFirst, // a key or '}'
+    stateKey,         // a key
+    stateColon,       // ':'
+    stateNext,        // ',' or the end of the current container
+    stateDone         // only white space
+  };
+
+  enum TokenType { tokenNone, tokenKey, tokenString, tokenNumber, tokenLiteral };
+
+  size_t position(const char* location) const;
+  void startToken(TokenType type, const char* location);
+  bool startValue(const char*& current, const char* end);
+  bool readString(const char*& current, const char* end);
+  bool decodeString();
+  bool readNumber(const char*& current, const char* end);
+  bool endNumber(const char* begin, const char* end);
+  bool readLiteral(const char*& current, const char* end);
+  bool openContainer(const char*& current);
+  bool closeContainer(const char*& current);
+  void valueRead();
+  bool report(bool proceed);
+  bool fail(const JSONCPP_STRING& message, size_t at);
+
+  EventHandler& handler_;
+  unsigned stackLimit_;
+
+  // '{' or '[' for each open container
+  std::vector<char> stack_;
+  State state_;
+  Status status_;
+
+  TokenType token_;
+  size_t tokenStart_;   // offset of the token within the document
+  bool escaped_;        // last string byte was a lone '\\'
+  bool hasEscapes_;
+  const char* literal_; // "true", "false" or "null"
+  unsigned literalPos_;
+  // Bytes of a token split across chunks or holding escapes
+  JSONCPP_STRING buffer_;
+  JSONCPP_STRING decoded_;
+
+  const char* chunk_;   // start of the chunk being parsed
+  size_t offset_;       // of chunk_ within the document
+  size_t errorOffset_;
+  JSONCPP_STRING error_;
+};
+
+} // namespace Json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+#endif // CPPTL_JSON_EVENTREADER_H_INCLUDED
@@ -0,0 +1,183 @@
+// Copyright 2007-2010 Baptiste Lepilleur
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef CPPTL_JSON_FLATMAP_H_INCLUDED
+#define CPPTL_JSON_FLATMAP_H_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Json {
+
+/** \brief Sorted vector with the subset of the std::map interface used by
+ * Value, selected as Value::ObjectValues by JSON_USE_FLAT_OBJECT_STORAGE.
+ *
+ * Members are stored contiguously in key order, so an object or array is
+ * built with a few growing allocations instead of one tree node per
+ * member. Lookups are a binary search; from indexThreshold members on,
+ * find() goes through an open-addressing hash index, rebuilt on the first
+ * lookup after a change. Key must provide hash().
+ *
+ * Inserting in the middle shifts the following members, which suits the
+ * small objects of typical messages. Unlike std::map, inserting or erasing
+ * invalidates iterators and references to other members.
+ */
+template <typename Key, typename T> class FlatMap {
+public:
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<Key, T> value_type;
+  typedef std::vector<value_type> Storage;
+  typedef typename Storage::iterator iterator;
+  typedef typename Storage::const_iterator const_iterator;
+  typedef typename Storage::size_type size_type;
+
+  enum { indexThreshold = 32 };
+
+  FlatMap() : indexed_(false) {}
+  FlatMap(const FlatMap& other) : items_(other.items_), indexed_(false) {}
+  FlatMap& operator=(FlatMap other) {
+    swap(other);
+    return *this;
+  }
+
+  void swap(FlatMap& other) {
+    items_.swap(other.items_);
+    index_.swap(other.index_);
+    std::swap(indexed_, other.indexed_);
+  }
+
+  iterator begin() { return items_.begin(); }
+  iterator end() { return items_.end(); }
+  const_iterator begin() const { return items_.begin(); }
+  const_iterator end() const { return items_.end(); }
+
+  size_type size() const { return items_.size(); }
+  bool empty() const { return items_.empty(); }
+
+  void clear() {
+    items_.clear();
+    invalidate();
+  }
+
+  iterator lower_bound(const Key& key) {
+    return std::lower_bound(items_.begin(), items_.end(), key, KeyLess());
+  }
+  const_iterator lower_bound(const Key& key) const {
+    return std::lower_bound(items_.begin(), items_.end(), key, KeyLess());
+  }
+
+  iterator find(const Key& key) { return items_.begin() + position(key); }
+  const_iterator find(const Key& key) const {
+    return items_.begin() + position(key);
+  }
+
+  /// Insert value at hint, which should come from lower_bound(); returns
+  /// the existing member if the key is already present.
+  iterator insert(iterator hint, const value_type& value) {
+    if (hint != items_.end() && !(value.first < hint->first))
+      hint = lower_bound(value.first);
+    else if (hint != items_.begin() && !((hint - 1)->first < value.first))
+      hint = lower_bound(value.first);
+    if (hint != items_.end() && hint->first == value.first)
+      return hint;
+    invalidate();
+    return items_.insert(hint, value);
+  }
+
+#if JSON_HAS_RVALUE_REFERENCES
+  iterator insert(iterator hint, value_type&& value) {
+    if (hint != items_.end() && !(value.first < hint->first))
+      hint = lower_bound(value.first);
+    else if (hint != items_.begin() && !((hint - 1)->first < value.first))
+      hint = lower_bound(value.first);
+    if (hint != items_.end() && hint->first == value.first)
+      return hint;
+    invalidate();
+    return items_.insert(hint, std::move(value));
+  }
+#endif
+
+  T& operator[](const Key& key) {
+    iterator it = lower_bound(key);
+    if (it == items_.end() || !(it->first == key))
+      it = insert(it, value_type(key, T()));
+    return it->second;
+  }
+
+  void erase(iterator it) {
+    invalidate();
+    items_.erase(it);
+  }
+
+  size_type erase(const Key& key) {
+    iterator it = find(key);
+    if (it == items_.end())
+      return 0;
+    erase(it);
+    return 1;
+  }
+
+  bool operator<(const FlatMap& other) const { return items_ < other.items_; }
+  bool operator==(const FlatMap& other) const {
+    return items_ == other.items_;
+  }
+
+private:
+  struct KeyLess {
+    bool operator()(const value_type& item, const Key& key) const {
+      return item.first < key;
+    }
+  };
+
+  void invalidate() { indexed_ = false; }
+
+  /// Position of key, or size() when absent.
+  size_type position(const Key& key) const {
+    if (items_.size() >= indexThreshold) {
+      if (!indexed_)
+        buildIndex();
+      size_type mask = index_.size() - 1;
+      for (size_type i = key.hash() & mask;; i = (i + 1) & mask) {
+        unsigned slot = index_[i];
+        if (slot == 0)
+          return items_.size();
+        if (items_[slot - 1].first == key)
+          return slot - 1;
+      }
+    }
+    const_iterator it = lower_bound(key);
+    if (it != items_.end() && it->first == key)
+      return size_type(it - items_.begin());
+    return items_.size();
+  }
+
+  void buildIndex() const {
+    // Power of two at least twice the member count: probes stay short
+    size_type capacity = 1;
+    while (capacity < items_.size() * 2)
+      capacity <<= 1;
+    index_.assign(capacity, 0);
+    size_type mask = capacity - 1;
+    for (size_type n = 0; n < items_.size(); ++n) {
+      size_type i = items_[n].first.hash() & mask;
+      while (index_[i] != 0)
+        i = (i + 1) & mask;
+      index_[i] = unsigned(n + 1);
+    }
+    indexed_ = true;
+  }
+
+  Storage items_;
+  // Member position + 1 per slot, 0 for an empty slot.
+  mutable std::vector<unsigned> index_;
+  mutable bool indexed_;
+};
+
+} // namespace Json
+
+#endif // CPPTL_JSON_FLATMAP_H_INCLUDED
@@ -9,6 +9,7 @@
 #include "autolink.h"
 #include "value.h"
 #include "reader.h"
+#include "eventreader.h"
 #include "writer.h"
 #include "features.h"
 
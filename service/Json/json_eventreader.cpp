@@ -0,0 +1,524 @@
+// Copyright 2007-2011 Baptiste Lepilleur
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include <json/assertions.h>
+#include <json/eventreader.h>
+#include "json_tool.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <cstring>
+#include <sstream>
+
+namespace Json {
+
+// Implementation of class EventHandler
+// ////////////////////////////////
+
+EventHandler::~EventHandler() {}
+
+bool EventHandler::startObject() { return true; }
+
+bool EventHandler::endObject() { return true; }
+
+bool EventHandler::startArray() { return true; }
+
+bool EventHandler::endArray() { return true; }
+
+bool EventHandler::key(const char*, const char*) { return true; }
+
+bool EventHandler::string(const char*, const char*) { return true; }
+
+bool EventHandler::number(const Value&) { return true; }
+
+bool EventHandler::boolean(bool) { return true; }
+
+bool EventHandler::null() { return true; }
+
+// Implementation of class EventReader
+// ////////////////////////////////
+
+static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static bool isNumberChar(char c) {
+  return isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' ||
+         c == 'E';
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool isValidNumber(const char* current, const char* end,
+                          bool& isInteger) {
+  isInteger = true;
+  if (current != end && *current == '-')
+    ++current;
+  if (current == end || !isDigit(*current))
+    return false;
+  if (*current++ != '0') {
+    while (current != end && isDigit(*current))
+      ++current;
+  }
+  if (current != end && *current == '.') {
+    isInteger = false;
+    const char* digits = ++current;
+    while (current != end && isDigit(*current))
+      ++current;
+    if (current == digits)
+      return false;
+  }
+  if (current != end && (*current == 'e' || *current == 'E')) {
+    isInteger = false;
+    ++current;
+    if (current != end && (*current == '+' || *current == '-'))
+      ++current;
+    const char* digits = current;
+    while (current != end && isDigit(*current))
+      ++current;
+    if (current == digits)
+      return false;
+  }
+  return current == end;
+}
+
+// Same results as Reader::decodeNumber().
+static bool decodeNumber(const char* begin, const char* end, Value& decoded) {
+  bool isInteger;
+  if (!isValidNumber(begin, end, isInteger))
+    return false;
+  if (isInteger) {
+    bool isNegative = *begin == '-';
+    const char* current = isNegative ? begin + 1 : begin;
+    Value::LargestUInt maxIntegerValue =
+        isNegative ? Value::LargestUInt(Value::maxLargestInt) + 1
+                   : Value::maxLargestUInt;
+    Value::LargestUInt threshold = maxIntegerValue / 10;
+    Value::LargestUInt value = 0;
+    bool fits = true;
+    while (fits && current != end) {
+      Value::UInt digit(static_cast<Value::UInt>(*current++ - '0'));
+      if (value >= threshold &&
+          (value > threshold || current != end ||
+           digit > maxIntegerValue % 10)) {
+        fits = false;
+      } else {
+        value = value * 10 + digit;
+      }
+    }
+    if (fits) {
+      if (isNegative && value == maxIntegerValue)
+        decoded = Value::minLargestInt;
+      else if (isNegative)
+        decoded = -Value::LargestInt(value);
+      else if (value <= Value::LargestUInt(Value::maxInt))
+        decoded = Value::LargestInt(value);
+      else
+        decoded = value;
+      return true;
+    }
+  }
+  double value = 0;
+  if (fastStringToDouble(begin, end, value)) {
+    decoded = value;
+    return true;
+  }
+  JSONCPP_ISTRINGSTREAM is(JSONCPP_STRING(begin, end));
+  if (!(is >> value))
+    return false;
+  decoded = value;
+  return true;
+}
+
+static bool decodeHex4(const char*& current, const char* end,
+                       unsigned int& unicode) {
+  if (end - current < 4)
+    return false;
+  unicode = 0;
+  for (int index = 0; index < 4; ++index) {
+    char c = *current++;
+    unicode *= 16;
+    if (c >= '0' && c <= '9')
+      unicode += c - '0';
+    else if (c >= 'a' && c <= 'f')
+      unicode += c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      unicode += c - 'A' + 10;
+    else
+      return false;
+  }
+  return true;
+}
+
+EventReader::EventReader(EventHandler& handler, unsigned stackLimit)
+    : handler_(handler), stackLimit_(stackLimit) {
+  reset();
+}
+
+void EventReader::reset() {
+  stack_.clear();
+  state_ = stateValue;
+  status_ = statusParsing;
+  token_ = tokenNone;
+  tokenStart_ = 0;
+  escaped_ = false;
+  hasEscapes_ = false;
+  literal_ = 0;
+  literalPos_ = 0;
+  buffer_.clear();
+  chunk_ = 0;
+  offset_ = 0;
+  errorOffset_ = 0;
+  error_.clear();
+}
+
+bool EventReader::parse(const char* begin, const char* end) {
+  reset();
+  feed(begin, end);
+  return finish();
+}
+
+bool EventReader::feed(const char* begin, const char* end) {
+  if (status_ != statusParsing)
+    return false;
+  chunk_ = begin;
+  const char* current = begin;
+  bool ok = true;
+  while (ok && current != end) {
+    switch (token_) {
+    case tokenKey:
+    case tokenString:
+      ok = readString(current, end);
+      continue;
+    case tokenNumber:
+      ok = readNumber(current, end);
+      continue;
+    case tokenLiteral:
+      ok = readLiteral(current, end);
+      continue;
+    case tokenNone:
+      break;
+    }
+
+    char c = *current;
+    if (isWhiteSpace(c)) {
+      current = skipWhiteSpace(current, end);
+      continue;
+    }
+    switch (state_) {
+    case stateValue:
+      ok = startValue(current, end);
+      break;
+    case stateArrayFirst:
+      if (c == ']')
+        ok = closeContainer(current);
+      else
+        ok = startValue(current, end);
+      break;
+    case stateObjectFirst:
+      if (c == '}') {
+        ok = closeContainer(current);
+        break;
+      }
+      // Else, fall through...
+    case stateKey:
+      if (c != '"') {
+        ok = fail("Missing '}' or object member name", position(current));
+        break;
+      }
+      startToken(tokenKey, current++);
+      break;
+    case stateColon:
+      if (c != ':') {
+        ok = fail("Missing ':' after object member name", position(current));
+        break;
+      }
+      ++current;
+      state_ = stateValue;
+      break;
+    case stateNext:
+      if (c == ',') {
+        ++current;
+        state_ = stack_.back() == '{' ? stateKey : stateValue;
+      } else if ((c == '}' && stack_.back() == '{') ||
+                 (c == ']' && stack_.back() == '[')) {
+        ok = closeContainer(current);
+      } else {
+        ok = fail(stack_.back() == '{'
+                      ? "Missing ',' or '}' in object declaration"
+                      : "Missing ',' or ']' in array declaration",
+                  position(current));
+      }
+      break;
+    case stateDone:
+      ok = fail("Extra non-whitespace after JSON value.", position(current));
+      break;
+    }
+  }
+  offset_ += static_cast<size_t>(current - begin);
+  return ok;
+}
+
+bool EventReader::finish() {
+  if (status_ == statusParsing && token_ == tokenNumber)
+    endNumber(buffer_.data(), buffer_.data() + buffer_.size());
+  if (status_ == statusParsing && !complete())
+    fail("Unexpected end of input.", offset_);
+  return status_ != statusFailed && complete();
+}
+
+bool EventReader::complete() const { return state_ == stateDone; }
+
+bool EventReader::stopped() const { return status_ == statusStopped; }
+
+bool EventReader::good() const { return status_ != statusFailed; }
+
+size_t EventReader::offset() const { return offset_; }
+
+JSONCPP_STRING EventReader::getFormattedErrorMessages() const {
+  if (good())
+    return JSONCPP_STRING();
+  JSONCPP_OSTRINGSTREAM oss;
+  oss << "* Offset " << errorOffset_ << "\n  " << error_ << "\n";
+  return oss.str();
+}
+
+size_t EventReader::position(const char* location) const {
+  return offset_ + static_cast<size_t>(location - chunk_);
+}
+
+void EventReader::startToken(TokenType type, const char* location) {
+  token_ = type;
+  tokenStart_ = position(location);
+  escaped_ = false;
+  hasEscapes_ = false;
+  buffer_.clear();
+}
+
+bool EventReader::startValue(const char*& current, const char*) {
+  switch (*current) {
+  case '{':
+  case '[':
+    return openContainer(current);
+  case '"':
+    startToken(tokenString, current++);
+    return true;
+  case 't':
+    literal_ = "true";
+    break;
+  case 'f':
+    literal_ = "false";
+    break;
+  case 'n':
+    literal_ = "null";
+    break;
+  default:
+    if (*current == '-' || isDigit(*current)) {
+      // Left for readNumber(), which may have to wait for the next chunk
+      startToken(tokenNumber, current);
+      return true;
+    }
+    return fail("Syntax error: value, object or array expected.",
+                position(current));
+  }
+  startToken(tokenLiteral, current);
+  literalPos_ = 0;
+  return true;
+}
+
+bool EventReader::readString(const char*& current, const char* end) {
+  const char* begin = current;
+  while (current != end) {
+    if (escaped_) {
+      escaped_ = false;
+      ++current;
+      continue;
+    }
+    current = findQuoteOrBackslash(current, end);
+    if (current == end || *current == '"')
+      break;
+    escaped_ = hasEscapes_ = true;
+    ++current;
+  }
+  if (current == end) {
+    // Continued in the next chunk
+    buffer_.append(begin, end);
+    return true;
+  }
+
+  const char* stringEnd = current++;
+  if (hasEscapes_ || !buffer_.empty()) {
+    buffer_.append(begin, stringEnd);
+    if (hasEscapes_) {
+      if (!decodeString())
+        return false;
+      begin = decoded_.data();
+      stringEnd = begin + decoded_.size();
+    } else {
+      begin = buffer_.data();
+      stringEnd = begin + buffer_.size();
+    }
+  }
+
+  if (token_ == tokenKey) {
+    token_ = tokenNone;
+    state_ = stateColon;
+    return report(handler_.key(begin, stringEnd));
+  }
+  token_ = tokenNone;
+  valueRead();
+  return report(handler_.string(begin, stringEnd));
+}
+
+bool EventReader::decodeString() {
+  decoded_.clear();
+  const char* current = buffer_.data();
+  const char* end = current + buffer_.size();
+  while (current != end) {
+    const char* escape =
+        static_cast<const char*>(memchr(current, '\\', end - current));
+    if (!escape) {
+      decoded_.append(current, end);
+      break;
+    }
+    decoded_.append(current, escape);
+    current = escape + 2; // readString() saw the escaped character
+    switch (escape[1]) {
+    case '"':
+      decoded_ += '"';
+      break;
+    case '/':
+      decoded_ += '/';
+      break;
+    case '\\':
+      decoded_ += '\\';
+      break;
+    case 'b':
+      decoded_ += '\b';
+      break;
+    case 'f':
+      decoded_ += '\f';
+      break;
+    case 'n':
+      decoded_ += '\n';
+      break;
+    case 'r':
+      decoded_ += '\r';
+      break;
+    case 't':
+      decoded_ += '\t';
+      break;
+    case 'u': {
+      unsigned int unicode;
+      if (!decodeHex4(current, end, unicode))
+        return fail(
+            "Bad unicode escape sequence in string: four digits expected.",
+            tokenStart_);
+      if (unicode >= 0xD800 && unicode <= 0xDBFF) {
+        unsigned int surrogatePair;
+        if (end - current < 6 || current[0] != '\\' || current[1] != 'u')
+          return fail("expecting another \\u token to begin the second half "
+                      "of a unicode surrogate pair",
+                      tokenStart_);
+        current += 2;
+        if (!decodeHex4(current, end, surrogatePair))
+          return fail(
+              "Bad unicode escape sequence in string: four digits expected.",
+              tokenStart_);
+        unicode =
+            0x10000 + ((unicode & 0x3FF) << 10) + (surrogatePair & 0x3FF);
+      }
+      decoded_ += codePointToUTF8(unicode);
+    } break;
+    default:
+      return fail("Bad escape sequence in string", tokenStart_);
+    }
+  }
+  return true;
+}
+
+bool EventReader::readNumber(const char*& current, const char* end) {
+  const char* begin = current;
+  while (current != end && isNumberChar(*current))
+    ++current;
+  if (current == end) {
+    // Continued in the next chunk, or completed by finish()
+    buffer_.append(begin, end);
+    return true;
+  }
+  if (buffer_.empty())
+    return endNumber(begin, current);
+  buffer_.append(begin, current);
+  return endNumber(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+bool EventReader::endNumber(const char* begin, const char* end) {
+  Value decoded;
+  if (!decodeNumber(begin, end, decoded))
+    return fail("'" + JSONCPP_STRING(begin, end) + "' is not a number.",
+                tokenStart_);
+  token_ = tokenNone;
+  valueRead();
+  return report(handler_.number(decoded));
+}
+
+bool EventReader::readLiteral(const char*& current, const char* end) {
+  while (current != end && literal_[literalPos_] != 0) {
+    if (*current != literal_[literalPos_])
+      return fail("Syntax error: value, object or array expected.",
+                  tokenStart_);
+    ++current;
+    ++literalPos_;
+  }
+  if (literal_[literalPos_] != 0)
+    return true; // Continued in the next chunk
+
+  token_ = tokenNone;
+  valueRead();
+  switch (literal_[0]) {
+  case 't':
+    return report(handler_.boolean(true));
+  case 'f':
+    return report(handler_.boolean(false));
+  default:
+    return report(handler_.null());
+  }
+}
+
+bool EventReader::openContainer(const char*& current) {
+  if (stack_.size() >= stackLimit_)
+    return fail("Exceeded stackLimit.", position(current));
+  char type = *current++;
+  stack_.push_back(type);
+  if (type == '{') {
+    state_ = stateObjectFirst;
+    return report(handler_.startObject());
+  }
+  state_ = stateArrayFirst;
+  return report(handler_.startArray());
+}
+
+bool EventReader::closeContainer(const char*& current) {
+  ++current;
+  char type = stack_.back();
+  stack_.pop_back();
+  valueRead();
+  return report(type == '{' ? handler_.endObject() : handler_.endArray());
+}
+
+void EventReader::valueRead() {
+  state_ = stack_.empty() ? stateDone : stateNext;
+}
+
+bool EventReader::report(bool proceed) {
+  if (!proceed)
+    status_ = statusStopped;
+  return proceed;
+}
+
+bool EventReader::fail(const JSONCPP_STRING& message, size_t at) {
+  status_ = statusFailed;
+  error_ = message;
+  errorOffset_ = at;
+  return false;
+}
+
+} // namespace Json
@@ -45,7 +45,6 @@
 #endif
 
 static int const stackLimit_g = 1000;
-static int       stackDepth_g = 0;  // see readValue()
 
 namespace Json {
 
@@ -89,11 +88,12 @@ static bool containsNewLine(Reader::Location begin, Reader::Location end) {
 Reader::Reader()
     : errors_(), document_(), begin_(), end_(), current_(), lastValueEnd_(),
       lastValue_(), commentsBefore_(), features_(Features::all()),
-      collectComments_() {}
+      collectComments_(), stackDepth_(0), arena_(0) {}
 
 Reader::Reader(const Features& features)
     : errors_(), document_(), begin_(), end_(), current_(), lastValueEnd_(),
-      lastValue_(), commentsBefore_(), features_(features), collectComments_() {
+      lastValue_(), commentsBefore_(), features_(features), collectComments_(),
+      stackDepth_(0), arena_(0) {
 }
 
 bool
@@ -138,7 +138,7 @@ bool Reader::parse(const char* beginDoc,
     nodes_.pop();
   nodes_.push(&root);
 
-  stackDepth_g = 0;  // Yes, this is bad coding, but options are limited.
+  stackDepth_ = 0;
   bool successful = readValue();
   Token token;
   skipCommentTokens(token);
@@ -161,12 +161,10 @@ bool Reader::parse(const char* beginDoc,
 }
 
 bool Reader::readValue() {
-  // This is a non-reentrant way to support a stackLimit. Terrible!
-  // But this deprecated class has a security problem: Bad input can
-  // cause a seg-fault. This seems like a fair, binary-compatible way
-  // to prevent the problem.
-  if (stackDepth_g >= stackLimit_g) throwRuntimeError("Exceeded stackLimit in readValue().");
-  ++stackDepth_g;
+  // This deprecated class has a security problem: Bad input can
+  // cause a seg-fault. Its Features have no stackLimit, so use a fixed one.
+  if (stackDepth_ >= stackLimit_g) throwRuntimeError("Exceeded stackLimit in readValue().");
+  ++stackDepth_;
 
   Token token;
   skipCommentTokens(token);
@@ -240,7 +238,7 @@ bool Reader::readValue() {
     lastValue_ = &currentValue();
   }
 
-  --stackDepth_g;
+  --stackDepth_;
   return successful;
 }
 
@@ -325,15 +323,7 @@ bool Reader::readToken(Token& token) {
   return true;
 }
 
-void Reader::skipSpaces() {
-  while (current_ != end_) {
-    Char c = *current_;
-    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
-      ++current_;
-    else
-      break;
-  }
-}
+void Reader::skipSpaces() { current_ = skipWhiteSpace(current_, end_); }
 
 bool Reader::match(Location pattern, int patternLength) {
   if (end_ - current_ < patternLength)
@@ -448,21 +438,21 @@ void Reader::readNumber() {
 }
 
 bool Reader::readString() {
-  Char c = '\0';
   while (current_ != end_) {
-    c = getNextChar();
-    if (c == '\\')
-      getNextChar();
-    else if (c == '"')
+    current_ = findQuoteOrBackslash(current_, end_);
+    if (current_ == end_)
       break;
+    if (*current_++ == '"')
+      return true;
+    getNextChar(); // escaped character
   }
-  return c == '"';
+  return false;
 }
 
 bool Reader::readObject(Token& tokenStart) {
   Token tokenName;
   JSONCPP_STRING name;
-  Value init(objectValue);
+  Value init(objectValue, arena_);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(tokenStart.start_ - begin_);
   while (readToken(tokenName)) {
@@ -491,7 +481,8 @@ bool Reader::readObject(Token& tokenStart) {
       return addErrorAndRecover(
           "Missing ':' after object member name", colon, tokenObjectEnd);
     }
-    Value& value = currentValue()[name];
+    Value& value = currentValue().resolveReference(
+        name.data(), name.data() + name.length(), arena_);
     nodes_.push(&value);
     bool ok = readValue();
     nodes_.pop();
@@ -516,7 +507,7 @@ bool Reader::readObject(Token& tokenStart) {
 }
 
 bool Reader::readArray(Token& tokenStart) {
-  Value init(arrayValue);
+  Value init(arrayValue, arena_);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(tokenStart.start_ - begin_);
   skipSpaces();
@@ -617,6 +608,10 @@ bool Reader::decodeDouble(Token& token) {
 
 bool Reader::decodeDouble(Token& token, Value& decoded) {
   double value = 0;
+  if (fastStringToDouble(token.start_, token.end_, value)) {
+    decoded = value;
+    return true;
+  }
   JSONCPP_STRING buffer(token.start_, token.end_);
   JSONCPP_ISTRINGSTREAM is(buffer);
   if (!(is >> value))
@@ -631,7 +626,8 @@ bool Reader::decodeString(Token& token) {
   JSONCPP_STRING decoded_string;
   if (!decodeString(token, decoded_string))
     return false;
-  Value decoded(decoded_string);
+  Value decoded(decoded_string.data(),
+                decoded_string.data() + decoded_string.length(), arena_);
   currentValue().swapPayload(decoded);
   currentValue().setOffsetStart(token.start_ - begin_);
   currentValue().setOffsetLimit(token.end_ - begin_);
@@ -643,6 +639,11 @@ bool Reader::decodeString(Token& token, JSONCPP_STRING& decoded) {
   Location current = token.start_ + 1; // skip '"'
   Location end = token.end_ - 1;       // do not include '"'
   while (current != end) {
+    Location run = findQuoteOrBackslash(current, end);
+    decoded.append(current, run);
+    if (run == end)
+      break;
+    current = run;
     Char c = *current++;
     if (c == '"')
       break;
@@ -684,8 +685,6 @@ bool Reader::decodeString(Token& token, JSONCPP_STRING& decoded) {
       default:
         return addError("Bad escape sequence in string", token, current);
       }
-    } else {
-      decoded += c;
     }
   }
   return true;
@@ -893,6 +892,47 @@ bool Reader::good() const {
   return !errors_.size();
 }
 
+// Class Document
+// //////////////////////////////////////////////////////////////////
+
+Document::Document() : arena_(), root_(), reader_() {}
+
+Document::Document(const Features& features, size_t blockSize)
+    : arena_(blockSize), root_(), reader_(features) {}
+
+bool Document::parse(const char* beginDoc, const char* endDoc) {
+  clear();
+  reader_.arena_ = &arena_;
+  bool ok;
+  try {
+    ok = reader_.parse(beginDoc, endDoc, root_, false);
+  } catch (...) {
+    reader_.arena_ = 0;
+    throw;
+  }
+  reader_.arena_ = 0;
+  return ok;
+}
+
+bool Document::parse(const std::string& document) {
+  return parse(document.data(), document.data() + document.length());
+}
+
+void Document::clear() {
+  Value().swap(root_);
+  arena_.clear();
+}
+
+Value& Document::root() { return root_; }
+
+const Value& Document::root() const { return root_; }
+
+JSONCPP_STRING Document::getFormattedErrorMessages() const {
+  return reader_.getFormattedErrorMessages();
+}
+
+const Arena& Document::arena() const { return arena_; }
+
 // exact copy of Features
 class OurFeatures {
 public:
@@ -1304,15 +1344,7 @@ bool OurReader::readToken(Token& token) {
   return true;
 }
 
-void OurReader::skipSpaces() {
-  while (current_ != end_) {
-    Char c = *current_;
-    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
-      ++current_;
-    else
-      break;
-  }
-}
+void OurReader::skipSpaces() { current_ = skipWhiteSpace(current_, end_); }
 
 bool OurReader::match(Location pattern, int patternLength) {
   if (end_ - current_ < patternLength)
@@ -1412,15 +1444,15 @@ bool OurReader::readNumber(bool checkInf) {
   return true;
 }
 bool OurReader::readString() {
-  Char c = 0;
   while (current_ != end_) {
-    c = getNextChar();
-    if (c == '\\')
-      getNextChar();
-    else if (c == '"')
+    current_ = findQuoteOrBackslash(current_, end_);
+    if (current_ == end_)
       break;
+    if (*current_++ == '"')
+      return true;
+    getNextChar(); // escaped character
   }
-  return c == '"';
+  return false;
 }
 
 
@@ -1606,6 +1638,10 @@ bool OurReader::decodeDouble(Token& token, Value& decoded) {
   if (length < 0) {
     return addError("Unable to parse token length", token);
   }
+  if (fastStringToDouble(token.start_, token.end_, value)) {
+    decoded = value;
+    return true;
+  }
   size_t const ulength = static_cast<size_t>(length);
 
   // Avoid using a string constant for the format control string given to
@@ -1649,6 +1685,11 @@ bool OurReader::decodeString(Token& token, JSONCPP_STRING& decoded) {
   Location current = token.start_ + 1; // skip '"'
   Location end = token.end_ - 1;       // do not include '"'
   while (current != end) {
+    Location run = findQuoteOrBackslash(current, end);
+    decoded.append(current, run);
+    if (run == end)
+      break;
+    current = run;
     Char c = *current++;
     if (c == '"')
       break;
@@ -1690,8 +1731,6 @@ bool OurReader::decodeString(Token& token, JSONCPP_STRING& decoded) {
       default:
         return addError("Bad escape sequence in string", token, current);
       }
-    } else {
-      decoded += c;
     }
   }
   return true;
@@ -6,6 +6,25 @@
 #ifndef LIB_JSONCPP_JSON_TOOL_H_INCLUDED
 #define LIB_JSONCPP_JSON_TOOL_H_INCLUDED
 
+#include <cstring>
+
+// SSE2 is part of every x86-64 CPU; AVX2 is only used if the CPU has it,
+// which GCC and Clang can check at run time.
+#if !defined(JSON_NO_SIMD) &&                                                  \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JSON_SCAN_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#elif (defined(__x86_64__) || defined(__i386__)) &&                            \
+    (defined(__clang__) ||                                                     \
+     __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define JSON_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
 /* This header provides common string manipulation support, such as UTF-8,
  * portable conversion from/to string...
  *
@@ -82,6 +101,466 @@ static inline void fixNumericLocale(char* begin, char* end) {
   }
 }
 
+#if defined(JSON_HAS_INT64)
+
+// Shortest round-trip formatting of doubles, using Florian Loitsch's Grisu2
+// ("Printing Floating-Point Numbers Quickly and Accurately with Integers",
+// PLDI 2010). Grisu2 always round-trips and finds the shortest digits for
+// nearly all values; the rest get one more digit than necessary.
+
+/// A double as significand * 2^exponent, with a 64-bit significand.
+struct DiyFp {
+  DiyFp() : f(0), e(0) {}
+  DiyFp(UInt64 significand, int exponent) : f(significand), e(exponent) {}
+
+  explicit DiyFp(double d) {
+    UInt64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    int biasedExponent = static_cast<int>((bits >> 52) & 0x7FF);
+    f = bits & 0x000FFFFFFFFFFFFFULL;
+    if (biasedExponent != 0) {
+      f += 0x0010000000000000ULL;
+      e = biasedExponent - 1075;
+    } else {
+      e = -1074;
+    }
+  }
+
+  DiyFp operator-(const DiyFp& other) const { return DiyFp(f - other.f, e); }
+
+  /// Product rounded to the upper 64 bits.
+  DiyFp operator*(const DiyFp& other) const {
+    const UInt64 mask32 = 0xFFFFFFFFULL;
+    UInt64 a = f >> 32, b = f & mask32;
+    UInt64 c = other.f >> 32, d = other.f & mask32;
+    UInt64 ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    UInt64 tmp = (bd >> 32) + (ad & mask32) + (bc & mask32);
+    tmp += UInt64(1) << 31;
+    return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + other.e + 64);
+  }
+
+  DiyFp normalize() const {
+    DiyFp result(*this);
+    while (!(result.f & 0x8000000000000000ULL)) {
+      result.f <<= 1;
+      result.e--;
+    }
+    return result;
+  }
+
+  /// Boundaries halfway to the neighbouring doubles, with the exponent of
+  /// the normalized upper one.
+  void normalizedBoundaries(DiyFp* minus, DiyFp* plus) const {
+    DiyFp upper((f << 1) + 1, e - 1);
+    while (!(upper.f & 0x0020000000000000ULL)) {
+      upper.f <<= 1;
+      upper.e--;
+    }
+    upper.f <<= 10;
+    upper.e -= 10;
+    // The lower boundary is closer when f is a power of two
+    DiyFp lower = f == 0x0010000000000000ULL ? DiyFp((f << 2) - 1, e - 2)
+                                              : DiyFp((f << 1) - 1, e - 1);
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+    *minus = lower;
+    *plus = upper;
+  }
+
+  UInt64 f;
+  int e;
+};
+
+/// Normalized 10^-k for the k that brings e into Grisu's target range.
+static inline DiyFp cachedPowerOfTen(int e, int* k) {
+  // 10^-348, 10^-340, ..., 10^340
+  static const struct { UInt64 f; short e; } powers[] = {
+      {0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193}, {0x8b16fb203055ac76ULL, -1166},
+      {0xcf42894a5dce35eaULL, -1140}, {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+      {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034}, {0xbe5691ef416bd60cULL, -1007},
+      {0x8dd01fad907ffc3cULL, -980}, {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+      {0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874}, {0x823c12795db6ce57ULL, -847},
+      {0xc21094364dfb5637ULL, -821}, {0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768},
+      {0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715}, {0xb23867fb2a35b28eULL, -688},
+      {0x84c8d4dfd2c63f3bULL, -661}, {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+      {0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555}, {0xf3e2f893dec3f126ULL, -529},
+      {0xb5b5ada8aaff80b8ULL, -502}, {0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449},
+      {0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396}, {0xa6dfbd9fb8e5b88fULL, -369},
+      {0xf8a95fcf88747d94ULL, -343}, {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+      {0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236}, {0xe45c10c42a2b3b06ULL, -210},
+      {0xaa242499697392d3ULL, -183}, {0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130},
+      {0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77}, {0x9c40000000000000ULL, -50},
+      {0xe8d4a51000000000ULL, -24}, {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+      {0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83}, {0xd5d238a4abe98068ULL, 109},
+      {0x9f4f2726179a2245ULL, 136}, {0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189},
+      {0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242}, {0x924d692ca61be758ULL, 269},
+      {0xda01ee641a708deaULL, 295}, {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+      {0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402}, {0xc83553c5c8965d3dULL, 428},
+      {0x952ab45cfa97a0b3ULL, 455}, {0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508},
+      {0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561}, {0x88fcf317f22241e2ULL, 588},
+      {0xcc20ce9bd35c78a5ULL, 614}, {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+      {0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720}, {0xbb764c4ca7a44410ULL, 747},
+      {0x8bab8eefb6409c1aULL, 774}, {0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827},
+      {0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880}, {0x80444b5e7aa7cf85ULL, 907},
+      {0xbf21e44003acdd2dULL, 933}, {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+      {0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039}, {0xaf87023b9bf0ee6bULL, 1066},
+  };
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int index = static_cast<int>(dk);
+  if (dk - index > 0.0)
+    index++;
+  index = (index >> 3) + 1;
+  *k = -(-348 + index * 8);
+  return DiyFp(powers[index].f, powers[index].e);
+}
+
+static inline void grisuRound(char* buffer, int length, UInt64 delta,
+                              UInt64 rest, UInt64 tenKappa, UInt64 distance) {
+  while (rest < distance && delta - rest >= tenKappa &&
+         (rest + tenKappa < distance ||
+          distance - rest > rest + tenKappa - distance)) {
+    buffer[length - 1]--;
+    rest += tenKappa;
+  }
+}
+
+static inline int countDecimalDigits(unsigned int n) {
+  int count = 1;
+  while (n >= 10 && count < 10) {
+    n /= 10;
+    ++count;
+  }
+  return count;
+}
+
+static inline void grisuDigits(const DiyFp& w, const DiyFp& upper,
+                               UInt64 delta, char* buffer, int* length,
+                               int* k) {
+  static const UInt64 pow10[] = {
+      1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+      10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+      100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+      100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+      100000000000000000ULL, 1000000000000000000ULL,
+      10000000000000000000ULL};
+  const DiyFp one(UInt64(1) << -upper.e, upper.e);
+  const DiyFp distance = upper - w;
+  unsigned int p1 = static_cast<unsigned int>(upper.f >> -one.e);
+  UInt64 p2 = upper.f & (one.f - 1);
+  int kappa = countDecimalDigits(p1);
+  *length = 0;
+
+  while (kappa > 0) {
+    unsigned int divisor = static_cast<unsigned int>(pow10[kappa - 1]);
+    unsigned int digit = p1 / divisor;
+    p1 %= divisor;
+    if (digit || *length)
+      buffer[(*length)++] = static_cast<char>('0' + digit);
+    kappa--;
+    UInt64 rest = (UInt64(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      grisuRound(buffer, *length, delta, rest, pow10[kappa] << -one.e,
+                 distance.f);
+      return;
+    }
+  }
+
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    char digit = static_cast<char>(p2 >> -one.e);
+    if (digit || *length)
+      buffer[(*length)++] = static_cast<char>('0' + digit);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      int index = -kappa;
+      grisuRound(buffer, *length, delta, p2, one.f,
+                 distance.f * (index < 20 ? pow10[index] : 0));
+      return;
+    }
+  }
+}
+
+/** Writes the shortest digits of value, a finite double > 0, to buffer:
+ * value is then about digits * 10^k.
+ * @return The number of digits, at most 17.
+ */
+static inline int grisu2(double value, char* buffer, int* k) {
+  const DiyFp v(value);
+  DiyFp minus, plus;
+  v.normalizedBoundaries(&minus, &plus);
+
+  const DiyFp cached = cachedPowerOfTen(plus.e, k);
+  const DiyFp w = v.normalize() * cached;
+  DiyFp upper = plus * cached;
+  DiyFp lower = minus * cached;
+  upper.f--;
+  lower.f++;
+  int length;
+  grisuDigits(w, upper, upper.f - lower.f, buffer, &length, k);
+  return length;
+}
+
+/** Converts a finite double to the shortest string that reads back as the
+ * same value, in the notation printf's "%.17g" would use.
+ * @param buffer Receives the nul-terminated string; at least 32 chars.
+ * @return The length of the string.
+ */
+static inline int doubleToShortestString(double value, char* buffer) {
+  char* current = buffer;
+  if (value < 0 || (value == 0 && 1 / value < 0)) {
+    *current++ = '-';
+    value = -value;
+  }
+  if (value == 0) {
+    *current++ = '0';
+    *current = 0;
+    return static_cast<int>(current - buffer);
+  }
+
+  char digits[20];
+  int k = 0;
+  int length = grisu2(value, digits, &k);
+  int exponent = length + k - 1; // of the first digit
+
+  if (exponent < -4 || exponent >= 17) {
+    // d[.ddd]e+XX
+    *current++ = digits[0];
+    if (length > 1) {
+      *current++ = '.';
+      memcpy(current, digits + 1, static_cast<size_t>(length - 1));
+      current += length - 1;
+    }
+    *current++ = 'e';
+    *current++ = exponent < 0 ? '-' : '+';
+    unsigned int e = static_cast<unsigned int>(exponent < 0 ? -exponent : exponent);
+    if (e >= 100)
+      *current++ = static_cast<char>('0' + e / 100);
+    *current++ = static_cast<char>('0' + e / 10 % 10);
+    *current++ = static_cast<char>('0' + e % 10);
+  } else if (exponent < 0) {
+    // 0.000ddd
+    *current++ = '0';
+    *current++ = '.';
+    for (int i = -1; i > exponent; --i)
+      *current++ = '0';
+    memcpy(current, digits, static_cast<size_t>(length));
+    current += length;
+  } else if (length <= exponent + 1) {
+    // ddd000
+    memcpy(current, digits, static_cast<size_t>(length));
+    current += length;
+    for (int i = length; i <= exponent; ++i)
+      *current++ = '0';
+  } else {
+    // ddd.ddd
+    memcpy(current, digits, static_cast<size_t>(exponent + 1));
+    current += exponent + 1;
+    *current++ = '.';
+    memcpy(current, digits + exponent + 1,
+           static_cast<size_t>(length - exponent - 1));
+    current += length - exponent - 1;
+  }
+  *current = 0;
+  return static_cast<int>(current - buffer);
+}
+
+/** Parses a JSON number into value when that can be done exactly with one
+ * floating-point operation (Clinger's fast path): at most 19 significant
+ * digits worth at most 2^53, scaled by 10^-22 to 10^22. That covers
+ * typical sensor readings and timestamps.
+ * @return false if [begin, end) needs a full parser (or is not a number).
+ */
+static inline bool fastStringToDouble(const char* begin, const char* end,
+                                      double& value) {
+  static const double pow10[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char* current = begin;
+  bool negative = current != end && *current == '-';
+  if (negative)
+    ++current;
+
+  UInt64 significand = 0;
+  int digits = 0;   // significant digits read
+  int exponent = 0; // of the last digit read
+  const char* digitsStart = current;
+  while (current != end && *current >= '0' && *current <= '9') {
+    if (digits || *current != '0') {
+      if (++digits > 19)
+        return false;
+      significand = significand * 10 + static_cast<unsigned>(*current - '0');
+    }
+    ++current;
+  }
+  if (current == digitsStart)
+    return false;
+  if (current != end && *current == '.') {
+    const char* fractionStart = ++current;
+    while (current != end && *current >= '0' && *current <= '9') {
+      if (digits || *current != '0') {
+        if (++digits > 19)
+          return false;
+        significand = significand * 10 + static_cast<unsigned>(*current - '0');
+      }
+      --exponent;
+      ++current;
+    }
+    if (current == fractionStart)
+      return false;
+  }
+  if (current != end && (*current == 'e' || *current == 'E')) {
+    ++current;
+    bool negativeExponent = current != end && *current == '-';
+    if (current != end && (*current == '-' || *current == '+'))
+      ++current;
+    const char* exponentStart = current;
+    int e = 0;
+    while (current != end && *current >= '0' && *current <= '9') {
+      if (e < 10000)
+        e = e * 10 + (*current - '0');
+      ++current;
+    }
+    if (current == exponentStart)
+      return false;
+    exponent += negativeExponent ? -e : e;
+  }
+  if (current != end || significand > (UInt64(1) << 53))
+    return false;
+
+  double result = static_cast<double>(significand);
+  if (significand != 0) {
+    if (exponent < -22 || exponent > 22)
+      return false;
+    if (exponent < 0)
+      result /= pow10[-exponent];
+    else
+      result *= pow10[exponent];
+  }
+  value = negative ? -result : result;
+  return true;
+}
+
+#else // if defined(JSON_HAS_INT64)
+
+static inline int doubleToShortestString(double, char*) { return -1; }
+
+static inline bool fastStringToDouble(const char*, const char*, double&) {
+  return false;
+}
+
+#endif // if defined(JSON_HAS_INT64)
+
+/// Returns true if ch is JSON white space.
+static inline bool isWhiteSpace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+#if defined(JSON_SCAN_SSE2)
+
+/// Index of the lowest set bit of a non-zero mask.
+static inline unsigned lowestBit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+/// Bit i is set if byte i of chunk is '"' or '\\'.
+static inline unsigned quoteOrBackslashMask(__m128i chunk) {
+  return static_cast<unsigned>(_mm_movemask_epi8(
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')),
+                   _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')))));
+}
+
+#endif // if defined(JSON_SCAN_SSE2)
+
+#if defined(JSON_SCAN_AVX2)
+
+static inline bool cpuHasAVX2() {
+  static const bool hasAVX2 = __builtin_cpu_supports("avx2") != 0;
+  return hasAVX2;
+}
+
+/** Looks for '"' or '\\' 32 bytes at a time.
+ * \return The byte found, or the start of the last 31 bytes or less.
+ */
+__attribute__((target("avx2"))) static inline const char*
+findQuoteOrBackslashAVX2(const char* current, const char* end) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  for (; end - current >= 32; current += 32) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current));
+    const unsigned mask = static_cast<unsigned>(
+        _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+                                             _mm256_cmpeq_epi8(chunk, backslash))));
+    if (mask != 0)
+      return current + lowestBit(mask);
+  }
+  return current;
+}
+
+#endif // if defined(JSON_SCAN_AVX2)
+
+/// Returns the first '"' or '\\' in [current, end), or end.
+static inline const char* findQuoteOrBackslash(const char* current,
+                                               const char* end) {
+#if defined(JSON_SCAN_AVX2)
+  // Most strings are short: only go wide when the first chunk has no match.
+  if (end - current >= 64 && cpuHasAVX2()) {
+    const unsigned mask = quoteOrBackslashMask(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(current)));
+    if (mask != 0)
+      return current + lowestBit(mask);
+    current = findQuoteOrBackslashAVX2(current + 16, end);
+  }
+#endif
+#if defined(JSON_SCAN_SSE2)
+  for (; end - current >= 16; current += 16) {
+    const unsigned mask = quoteOrBackslashMask(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(current)));
+    if (mask != 0)
+      return current + lowestBit(mask);
+  }
+#endif
+  while (current != end && *current != '"' && *current != '\\')
+    ++current;
+  return current;
+}
+
+/// Returns the first byte of [current, end) that is not white space, or end.
+static inline const char* skipWhiteSpace(const char* current,
+                                         const char* end) {
+  // Compact documents have none at all: test one byte before loading 16.
+  if (current == end || !isWhiteSpace(*current))
+    return current;
+#if defined(JSON_SCAN_SSE2)
+  for (; end - current >= 16; current += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+    const __m128i space = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+    const unsigned mask =
+        ~static_cast<unsigned>(_mm_movemask_epi8(space)) & 0xFFFFu;
+    if (mask != 0)
+      return current + lowestBit(mask);
+  }
+#endif
+  while (current != end && isWhiteSpace(*current))
+    ++current;
+  return current;
+}
+
 } // namespace Json {
 
 #endif // LIB_JSONCPP_JSON_TOOL_H_INCLUDED
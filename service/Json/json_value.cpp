@@ -18,6 +18,7 @@
 #endif
 #include <cstddef> // size_t
 #include <algorithm> // min()
+#include <new> // placement new in Arena-backed Values
 
 #define JSON_ASSERT_UNREACHABLE assert(false)
 
@@ -214,6 +215,54 @@ JSONCPP_NORETURN void throwLogicError(JSONCPP_STRING const& msg)
   throw LogicError(msg);
 }
 
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class Arena
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+Arena::Arena(size_t blockSize)
+    : blockSize_(blockSize), current_(0), end_(0), used_(0) {}
+
+Arena::~Arena() {
+  for (size_t i = 0; i < blocks_.size(); ++i)
+    free(blocks_[i].data_);
+}
+
+void* Arena::allocate(size_t size) {
+  size = (size + alignment - 1) & ~(alignment - 1);
+  if (static_cast<size_t>(end_ - current_) < size) {
+    // Oversized requests get a block of their own
+    Block block;
+    block.size_ = size > blockSize_ ? size : blockSize_;
+    block.data_ = static_cast<char*>(malloc(block.size_));
+    if (block.data_ == NULL)
+      throwRuntimeError("in Json::Arena::allocate(): out of memory");
+    blocks_.push_back(block);
+    current_ = block.data_;
+    end_ = block.data_ + block.size_;
+  }
+  void* p = current_;
+  current_ += size;
+  used_ += size;
+  return p;
+}
+
+void Arena::clear() {
+  if (blocks_.empty())
+    return;
+  for (size_t i = 1; i < blocks_.size(); ++i)
+    free(blocks_[i].data_);
+  blocks_.resize(1);
+  current_ = blocks_[0].data_;
+  end_ = blocks_[0].data_ + blocks_[0].size_;
+  used_ = 0;
+}
+
+size_t Arena::used() const { return used_; }
+
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
@@ -275,7 +324,7 @@ Value::CZString::CZString(const CZString& other) {
 }
 
 #if JSON_HAS_RVALUE_REFERENCES
-Value::CZString::CZString(CZString&& other)
+Value::CZString::CZString(CZString&& other) JSONCPP_NOEXCEPT
   : cstr_(other.cstr_), index_(other.index_) {
   other.cstr_ = nullptr;
 }
@@ -325,6 +374,17 @@ bool Value::CZString::operator==(const CZString& other) const {
 
 ArrayIndex Value::CZString::index() const { return index_; }
 
+size_t Value::CZString::hash() const {
+  if (!cstr_) return size_t(index_) * 2654435761u;
+  // FNV-1a
+  size_t h = 2166136261u;
+  for (unsigned i = 0; i < storage_.length_; ++i) {
+    h ^= static_cast<unsigned char>(cstr_[i]);
+    h *= 16777619u;
+  }
+  return h;
+}
+
 //const char* Value::CZString::c_str() const { return cstr_; }
 const char* Value::CZString::data() const { return cstr_; }
 unsigned Value::CZString::length() const { return storage_.length_; }
@@ -428,8 +488,37 @@ Value::Value(bool value) {
   value_.bool_ = value;
 }
 
+Value::Value(ValueType vtype, Arena* arena) {
+  initBasic(nullValue);
+  if (arena && (vtype == arrayValue || vtype == objectValue)) {
+    type_ = vtype;
+    arena_ = true;
+    value_.map_ = new (arena->allocate(sizeof(ObjectValues))) ObjectValues();
+  } else {
+    Value plain(vtype);
+    swapPayload(plain);
+  }
+}
+
+Value::Value(const char* beginValue, const char* endValue, Arena* arena) {
+  initBasic(stringValue, true);
+  unsigned length = static_cast<unsigned>(endValue - beginValue);
+  if (!arena) {
+    value_.string_ = duplicateAndPrefixStringValue(beginValue, length);
+    return;
+  }
+  // Same layout as duplicateAndPrefixStringValue()
+  char* newString = static_cast<char*>(
+      arena->allocate(sizeof(unsigned) + length + 1U));
+  *reinterpret_cast<unsigned*>(newString) = length;
+  memcpy(newString + sizeof(unsigned), beginValue, length);
+  newString[sizeof(unsigned) + length] = 0;
+  value_.string_ = newString;
+  arena_ = true;
+}
+
 Value::Value(Value const& other)
-    : type_(other.type_), allocated_(false)
+    : type_(other.type_), allocated_(false), arena_(false)
       ,
       comments_(0), start_(other.start_), limit_(other.limit_)
 {
@@ -474,7 +563,7 @@ Value::Value(Value const& other)
 
 #if JSON_HAS_RVALUE_REFERENCES
 // Move constructor
-Value::Value(Value&& other) {
+Value::Value(Value&& other) JSONCPP_NOEXCEPT {
   initBasic(nullValue);
   swap(other);
 }
@@ -489,12 +578,15 @@ Value::~Value() {
   case booleanValue:
     break;
   case stringValue:
-    if (allocated_)
+    if (allocated_ && !arena_)
       releasePrefixedStringValue(value_.string_);
     break;
   case arrayValue:
   case objectValue:
-    delete value_.map_;
+    if (arena_)
+      value_.map_->~ObjectValues();
+    else
+      delete value_.map_;
     break;
   default:
     JSON_ASSERT_UNREACHABLE;
@@ -519,6 +611,9 @@ void Value::swapPayload(Value& other) {
   int temp2 = allocated_;
   allocated_ = other.allocated_;
   other.allocated_ = temp2 & 0x1;
+  temp2 = arena_;
+  arena_ = other.arena_;
+  other.arena_ = temp2 & 0x1;
 }
 
 void Value::swap(Value& other) {
@@ -1017,8 +1112,12 @@ const Value& Value::operator[](int index) const {
 }
 
 void Value::initBasic(ValueType vtype, bool allocated) {
+  // Every constructor sets value_ afterwards, except the move constructor,
+  // which swaps it out: keep it from ever being read uninitialized.
+  memset(&value_, 0, sizeof(value_));
   type_ = vtype;
   allocated_ = allocated;
+  arena_ = false;
   comments_ = 0;
   start_ = 0;
   limit_ = 0;
@@ -1065,6 +1164,39 @@ Value& Value::resolveReference(char const* key, char const* cend)
   return value;
 }
 
+// Like resolveReference(key, end), but a new key is copied into arena when
+// one is given. The key keeps the duplicateOnCopy policy, so it is never
+// freed and copies of the member get their own key.
+Value& Value::resolveReference(char const* key, char const* cend, Arena* arena)
+{
+#if JSON_HAS_RVALUE_REFERENCES
+  if (!arena)
+    return resolveReference(key, cend);
+  JSON_ASSERT_MESSAGE(
+      type_ == nullValue || type_ == objectValue,
+      "in Json::Value::resolveReference(key, end): requires objectValue");
+  if (type_ == nullValue)
+    *this = Value(objectValue);
+  unsigned length = static_cast<unsigned>(cend - key);
+  CZString actualKey(key, length, CZString::duplicateOnCopy);
+  ObjectValues::iterator it = value_.map_->lower_bound(actualKey);
+  if (it != value_.map_->end() && (*it).first == actualKey)
+    return (*it).second;
+
+  char* storedKey = static_cast<char*>(arena->allocate(length + 1U));
+  memcpy(storedKey, key, length);
+  storedKey[length] = 0;
+  ObjectValues::value_type member(
+      CZString(storedKey, length, CZString::duplicateOnCopy), Value());
+  it = value_.map_->insert(it, std::move(member));
+  return (*it).second;
+#else
+  // Inserting would copy the key to the heap anyway.
+  (void)arena;
+  return resolveReference(key, cend);
+#endif
+}
+
 Value Value::get(ArrayIndex index, const Value& defaultValue) const {
   const Value* value = &((*this)[index]);
   return value == &nullSingleton() ? defaultValue : *value;
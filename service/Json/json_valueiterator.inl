@@ -37,7 +37,10 @@ void ValueIteratorBase::decrement() {
 
 ValueIteratorBase::difference_type
 ValueIteratorBase::computeDistance(const SelfType& other) const {
-#ifdef JSON_USE_CPPTL_SMALLMAP
+#if defined(JSON_USE_CPPTL_SMALLMAP) || defined(JSON_USE_FLAT_OBJECT_STORAGE)
+  if (isNull_ && other.isNull_) {
+    return 0;
+  }
   return other.current_ - current_;
 #else
   // Iterator for null value are initialized using the default
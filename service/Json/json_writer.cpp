@@ -136,20 +136,24 @@ JSONCPP_STRING valueToString(UInt value) {
 #endif // # if defined(JSON_HAS_INT64)
 
 namespace {
-JSONCPP_STRING valueToString(double value, bool useSpecialFloats, unsigned int precision) {
-  // Allocate a buffer that is more than large enough to store the 16 digits of
-  // precision requested below.
-  char buffer[32];
+// Writes value into buffer and returns its length.
+int formatDouble(double value, bool useSpecialFloats, unsigned int precision,
+                 char (&buffer)[32]) {
   int len = -1;
 
-  char formatString[6];
-  sprintf(formatString, "%%.%dg", precision);
-
   // Print into the buffer. We need not request the alternative representation
   // that always has a decimal point because JSON doesn't distingish the
   // concepts of reals and integers.
   if (isfinite(value)) {
-    len = snprintf(buffer, sizeof(buffer), formatString, value);
+    // Full precision only has to read back as the same value: the shortest
+    // such digits are both faster to produce and more readable.
+    if (precision >= 17)
+      len = doubleToShortestString(value, buffer);
+    if (len < 0) {
+      char formatString[6];
+      sprintf(formatString, "%%.%dg", precision);
+      len = snprintf(buffer, sizeof(buffer), formatString, value);
+    }
   } else {
     // IEEE standard states that NaN values will not compare to themselves
     if (value != value) {
@@ -163,7 +167,15 @@ JSONCPP_STRING valueToString(double value, bool useSpecialFloats, unsigned int p
   }
   assert(len >= 0);
   fixNumericLocale(buffer, buffer + len);
-  return buffer;
+  return len;
+}
+
+JSONCPP_STRING valueToString(double value, bool useSpecialFloats, unsigned int precision) {
+  // Allocate a buffer that is more than large enough to store the 16 digits of
+  // precision requested below.
+  char buffer[32];
+  int len = formatDouble(value, useSpecialFloats, precision, buffer);
+  return JSONCPP_STRING(buffer, static_cast<size_t>(len));
 }
 }
 
@@ -1215,4 +1227,262 @@ JSONCPP_OSTREAM& operator<<(JSONCPP_OSTREAM& sout, Value const& root) {
   return sout;
 }
 
+//////////////////////////
+// BufferWriter
+
+namespace {
+
+inline void append(JSONCPP_STRING& out, const char* text, size_t length) {
+  out.append(text, length);
+}
+
+inline void append(std::vector<char>& out, const char* text, size_t length) {
+  out.insert(out.end(), text, text + length);
+}
+
+template <typename Buffer>
+inline void append(Buffer& out, const JSONCPP_STRING& text) {
+  append(out, text.data(), text.size());
+}
+
+/// Like valueToQuotedStringN(), but copies unescaped runs straight to out.
+template <typename Buffer>
+void appendQuoted(Buffer& out, const char* str, const char* end) {
+  static const char hex[] = "0123456789ABCDEF";
+  out.push_back('"');
+  const char* run = str;
+  for (const char* c = str; c != end; ++c) {
+    unsigned char const ch = static_cast<unsigned char>(*c);
+    if (ch >= 0x20 && ch != '"' && ch != '\\')
+      continue;
+    append(out, run, static_cast<size_t>(c - run));
+    run = c + 1;
+    char escape[6] = { '\\', 0, 0, 0, 0, 0 };
+    size_t length = 2;
+    switch (ch) {
+    case '"':  escape[1] = '"'; break;
+    case '\\': escape[1] = '\\'; break;
+    case '\b': escape[1] = 'b'; break;
+    case '\f': escape[1] = 'f'; break;
+    case '\n': escape[1] = 'n'; break;
+    case '\r': escape[1] = 'r'; break;
+    case '\t': escape[1] = 't'; break;
+    default:
+      escape[1] = 'u';
+      escape[2] = '0';
+      escape[3] = '0';
+      escape[4] = hex[ch >> 4];
+      escape[5] = hex[ch & 0xf];
+      length = 6;
+      break;
+    }
+    append(out, escape, length);
+  }
+  append(out, run, static_cast<size_t>(end - run));
+  out.push_back('"');
+}
+
+template <typename Buffer>
+void appendMemberName(Buffer& out, Value::const_iterator const& it) {
+  char const* end;
+  char const* name = it.memberName(&end);
+  appendQuoted(out, name, end);
+}
+
+} // namespace
+
+BufferWriter::BufferWriter()
+    : colonSymbol_(":"), nullSymbol_("null"), useSpecialFloats_(false),
+      precision_(17) {}
+
+BufferWriter::BufferWriter(const Value& settings)
+    : indentation_(settings.get("indentation", "").asString()),
+      nullSymbol_(settings.get("dropNullPlaceholders", false).asBool()
+                      ? ""
+                      : "null"),
+      useSpecialFloats_(settings.get("useSpecialFloats", false).asBool()),
+      precision_(settings.get("precision", 17).asUInt()) {
+  if (settings.get("enableYAMLCompatibility", false).asBool())
+    colonSymbol_ = ": ";
+  else if (indentation_.empty())
+    colonSymbol_ = ":";
+  else
+    colonSymbol_ = " : ";
+  if (precision_ > 17)
+    precision_ = 17;
+}
+
+template <typename Buffer>
+void BufferWriter::writeScalar(const Value& value, Buffer& out) const {
+  switch (value.type()) {
+  case nullValue:
+    append(out, nullSymbol_);
+    break;
+  case intValue: {
+    UIntToStringBuffer buffer;
+    char* const end = buffer + sizeof(buffer) - 1;
+    char* current = end + 1;
+    LargestInt const i = value.asLargestInt();
+    // Negating in unsigned arithmetic also covers minLargestInt.
+    uintToString(i < 0 ? 0 - LargestUInt(i) : LargestUInt(i), current);
+    if (i < 0)
+      *--current = '-';
+    append(out, current, static_cast<size_t>(end - current));
+  } break;
+  case uintValue: {
+    UIntToStringBuffer buffer;
+    char* const end = buffer + sizeof(buffer) - 1;
+    char* current = end + 1;
+    uintToString(value.asLargestUInt(), current);
+    append(out, current, static_cast<size_t>(end - current));
+  } break;
+  case realValue: {
+    char buffer[32];
+    int len = formatDouble(value.asDouble(), useSpecialFloats_, precision_,
+                           buffer);
+    append(out, buffer, static_cast<size_t>(len));
+  } break;
+  case stringValue: {
+    char const* str;
+    char const* end;
+    if (value.getString(&str, &end))
+      appendQuoted(out, str, end);
+  } break;
+  case booleanValue:
+    if (value.asBool())
+      append(out, "true", 4);
+    else
+      append(out, "false", 5);
+    break;
+  case arrayValue:
+    append(out, "[]", 2);
+    break;
+  case objectValue:
+    append(out, "{}", 2);
+    break;
+  }
+}
+
+template <typename Buffer>
+void BufferWriter::writeCompact(const Value& value, Buffer& out) const {
+  switch (value.type()) {
+  case arrayValue: {
+    out.push_back('[');
+    Value::const_iterator const end = value.end();
+    for (Value::const_iterator it = value.begin(); it != end; ++it) {
+      if (it != value.begin())
+        out.push_back(',');
+      writeCompact(*it, out);
+    }
+    out.push_back(']');
+  } break;
+  case objectValue: {
+    out.push_back('{');
+    Value::const_iterator const end = value.end();
+    for (Value::const_iterator it = value.begin(); it != end; ++it) {
+      if (it != value.begin())
+        out.push_back(',');
+      appendMemberName(out, it);
+      append(out, colonSymbol_);
+      writeCompact(*it, out);
+    }
+    out.push_back('}');
+  } break;
+  default:
+    writeScalar(value, out);
+    break;
+  }
+}
+
+template <typename Buffer>
+void BufferWriter::writeIndent(Buffer& out, unsigned depth) const {
+  out.push_back('\n');
+  for (unsigned i = 0; i < depth; ++i)
+    append(out, indentation_);
+}
+
+// Same layout as BuiltStyledStreamWriter: a non-empty object, or an array
+// that does not fit on one line, starts on a line of its own after a key.
+template <typename Buffer>
+void BufferWriter::writeIndented(const Value& value, Buffer& out,
+                                 unsigned depth, bool newLine) const {
+  static const ArrayIndex rightMargin = 74;
+  switch (value.type()) {
+  case arrayValue: {
+    ArrayIndex const size = value.size();
+    if (size == 0) {
+      append(out, "[]", 2);
+      break;
+    }
+    Value::const_iterator const end = value.end();
+    bool isMultiLine = size * 3 >= rightMargin;
+    for (Value::const_iterator it = value.begin(); it != end && !isMultiLine;
+         ++it)
+      isMultiLine = (it->isArray() || it->isObject()) && it->size() > 0;
+    if (!isMultiLine) {
+      // Only scalars: write them on one line, and take it back if too long.
+      size_t const start = out.size();
+      append(out, "[ ", 2);
+      for (Value::const_iterator it = value.begin(); it != end; ++it) {
+        if (it != value.begin())
+          append(out, ", ", 2);
+        writeScalar(*it, out);
+      }
+      append(out, " ]", 2);
+      if (out.size() - start < rightMargin)
+        break;
+      out.resize(start);
+    }
+    if (newLine)
+      writeIndent(out, depth);
+    out.push_back('[');
+    for (Value::const_iterator it = value.begin(); it != end; ++it) {
+      if (it != value.begin())
+        out.push_back(',');
+      writeIndent(out, depth + 1);
+      writeIndented(*it, out, depth + 1, false);
+    }
+    writeIndent(out, depth);
+    out.push_back(']');
+  } break;
+  case objectValue: {
+    if (value.empty()) {
+      append(out, "{}", 2);
+      break;
+    }
+    if (newLine)
+      writeIndent(out, depth);
+    out.push_back('{');
+    Value::const_iterator const end = value.end();
+    for (Value::const_iterator it = value.begin(); it != end; ++it) {
+      if (it != value.begin())
+        out.push_back(',');
+      writeIndent(out, depth + 1);
+      appendMemberName(out, it);
+      append(out, colonSymbol_);
+      writeIndented(*it, out, depth + 1, true);
+    }
+    writeIndent(out, depth);
+    out.push_back('}');
+  } break;
+  default:
+    writeScalar(value, out);
+    break;
+  }
+}
+
+void BufferWriter::write(const Value& root, JSONCPP_STRING& out) const {
+  if (indentation_.empty())
+    writeCompact(root, out);
+  else
+    writeIndented(root, out, 0, false);
+}
+
+void BufferWriter::write(const Value& root, std::vector<char>& out) const {
+  if (indentation_.empty())
+    writeCompact(root, out);
+  else
+    writeIndented(root, out, 0, false);
+}
+
 } // namespace Json
@@ -17,6 +17,14 @@
 /// std::map
 /// as Value container.
 //#  define JSON_USE_CPPTL_SMALLMAP 1
+/// If defined, objects and arrays store their members in a sorted vector
+/// (Json::FlatMap) with a hash index for large objects, instead of one
+/// std::map node per member. Iterators and references to members are then
+/// invalidated by inserting or erasing other members of the same value.
+//#  define JSON_USE_FLAT_OBJECT_STORAGE 1
+/// If defined, the readers scan strings and white space one byte at a time
+/// instead of with SSE2 (and AVX2 when the CPU has it) on x86.
+//#  define JSON_NO_SIMD 1
 
 // If non-zero, the library uses exceptions to report bad input instead of C
 // assertion macros. The default is to use exceptions.
@@ -88,6 +96,15 @@
 # define JSONCPP_OVERRIDE
 #endif
 
+// Lets containers move rather than copy Values when they grow.
+#if __cplusplus >= 201103L
+# define JSONCPP_NOEXCEPT noexcept
+#elif defined(_MSC_VER) && _MSC_VER >= 1900
+# define JSONCPP_NOEXCEPT noexcept
+#else
+# define JSONCPP_NOEXCEPT
+#endif
+
 #ifndef JSON_HAS_RVALUE_REFERENCES
 
 #if defined(_MSC_VER) && _MSC_VER >= 1600 // MSVC >= 2010
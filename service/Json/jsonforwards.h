@@ -18,6 +18,10 @@ class StyledWriter;
 
 // reader.h
 class Reader;
+class Arena;
+class Document;
+class EventHandler;
+class EventReader;
 
 // features.h
 class Features;
@@ -156,6 +156,8 @@ public:
   bool good() const;
 
 private:
+  friend class Document;
+
   enum TokenType {
     tokenEndOfStream = 0,
     tokenObjectBegin,
@@ -240,8 +242,56 @@ private:
   JSONCPP_STRING commentsBefore_;
   Features features_;
   bool collectComments_;
+  int stackDepth_;
+  Arena* arena_; // set while a Document is parsed
 };  // Reader
 
+/** \brief A parsed <a HREF="http://www.json.org">JSON</a> document whose
+ * strings and containers live in an Arena.
+ *
+ * Parsing into a Document costs one allocation per arena block instead of
+ * one per string and per container, and parsing again or destroying the
+ * Document releases the whole tree at once. Comments are not collected.
+ *
+ * Copies of root() or of its members are ordinary Values. References into
+ * the tree, and Values moved or swapped out of it, are only valid until the
+ * next parse() or the destruction of the Document.
+ *
+ * A Document, like a Reader, must only be used by one thread at a time.
+ */
+class JSON_API Document {
+public:
+  Document();
+  explicit Document(const Features& features, size_t blockSize = 16 * 1024);
+
+  /// Replace the tree with the one parsed from [beginDoc, endDoc).
+  /// The tree does not reference the text, but getFormattedErrorMessages()
+  /// does.
+  bool parse(const char* beginDoc, const char* endDoc);
+  bool parse(const std::string& document);
+
+  /// Release the tree, keeping the first arena block for the next parse().
+  void clear();
+
+  Value& root();
+  const Value& root() const;
+
+  /// \see Reader::getFormattedErrorMessages()
+  JSONCPP_STRING getFormattedErrorMessages() const;
+
+  /// Arena statistics, e.g. arena().used() after a parse.
+  const Arena& arena() const;
+
+private:
+  Document(const Document&);
+  Document& operator=(const Document&);
+
+  // Declared first: the tree must be destroyed before its memory.
+  Arena arena_;
+  Value root_;
+  Reader reader_;
+};
+
 /** Interface for reading JSON from a char array.
  */
 class JSON_API CharReader {
@@ -13,7 +13,9 @@
 #include <vector>
 #include <exception>
 
-#ifndef JSON_USE_CPPTL_SMALLMAP
+#if defined(JSON_USE_FLAT_OBJECT_STORAGE)
+#include "flatmap.h"
+#elif !defined(JSON_USE_CPPTL_SMALLMAP)
 #include <map>
 #else
 #include <cpptl/smallmap.h>
@@ -138,6 +140,44 @@ private:
   const char* c_str_;
 };
 
+/** \brief Bump allocator holding the strings and containers of a Document.
+ *
+ * Memory is carved out of large blocks and only released all at once, by
+ * clear() or the destructor. Not thread-safe: use one arena per thread.
+ */
+class JSON_API Arena {
+public:
+  /// Every allocation is aligned to this many bytes.
+  static const size_t alignment = 2 * sizeof(void*);
+
+  explicit Arena(size_t blockSize = 16 * 1024);
+  ~Arena();
+
+  /// Uninitialised memory, valid until clear() or destruction.
+  void* allocate(size_t size);
+
+  /// Release all memory, keeping the first block for reuse.
+  void clear();
+
+  /// Bytes handed out since construction or the last clear().
+  size_t used() const;
+
+private:
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  struct Block {
+    char* data_;
+    size_t size_;
+  };
+
+  std::vector<Block> blocks_;
+  size_t blockSize_;
+  char* current_;
+  char* end_;
+  size_t used_;
+};
+
 /** \brief Represents a <a HREF="http://www.json.org">JSON</a> value.
  *
  * This class is a discriminated union wrapper that can represents a:
@@ -228,7 +268,7 @@ private:
     CZString(char const* str, unsigned length, DuplicationPolicy allocate);
     CZString(CZString const& other);
 #if JSON_HAS_RVALUE_REFERENCES
-    CZString(CZString&& other);
+    CZString(CZString&& other) JSONCPP_NOEXCEPT;
 #endif
     ~CZString();
     CZString& operator=(CZString other);
@@ -239,6 +279,8 @@ private:
     char const* data() const;
     unsigned length() const;
     bool isStaticString() const;
+    /// Hash of the index or string, for FlatMap's index.
+    size_t hash() const;
 
   private:
     void swap(CZString& other);
@@ -256,7 +298,9 @@ private:
   };
 
 public:
-#ifndef JSON_USE_CPPTL_SMALLMAP
+#if defined(JSON_USE_FLAT_OBJECT_STORAGE)
+  typedef FlatMap<CZString, Value> ObjectValues;
+#elif !defined(JSON_USE_CPPTL_SMALLMAP)
   typedef std::map<CZString, Value> ObjectValues;
 #else
   typedef CppTL::SmallMap<CZString, Value> ObjectValues;
@@ -314,7 +358,7 @@ Json::Value obj_value(Json::objectValue); // {}
   Value(const Value& other);
 #if JSON_HAS_RVALUE_REFERENCES
   /// Move constructor
-  Value(Value&& other);
+  Value(Value&& other) JSONCPP_NOEXCEPT;
 #endif
   ~Value();
 
@@ -578,10 +622,18 @@ Json::Value obj_value(Json::objectValue); // {}
   ptrdiff_t getOffsetLimit() const;
 
 private:
+  friend class Reader;
+
+  // Used by Reader to build a Document: with a non-null arena, containers
+  // and strings are placed in it instead of the heap.
+  Value(ValueType type, Arena* arena);
+  Value(const char* begin, const char* end, Arena* arena);
+
   void initBasic(ValueType type, bool allocated = false);
 
   Value& resolveReference(const char* key);
   Value& resolveReference(const char* key, const char* end);
+  Value& resolveReference(const char* key, const char* end, Arena* arena);
 
   struct CommentInfo {
     CommentInfo();
@@ -612,6 +664,8 @@ private:
   ValueType type_ : 8;
   unsigned int allocated_ : 1; // Notes: if declared as bool, bitfield is useless.
                                // If not allocated_, string_ must be null-terminated.
+  unsigned int arena_ : 1;     // string_ or map_ lives in an Arena: it is
+                               // destroyed in place but never freed.
   CommentInfo* comments_;
 
   // [start, limit) byte offsets in the source JSON text from which this Value
@@ -103,6 +103,10 @@ public:
       - If true, outputs non-finite floating point values in the following way:
         NaN values as "NaN", positive infinity as "Infinity", and negative infinity
         as "-Infinity".
+    - "precision": int
+      - Number of significant digits for doubles, at most 17. With 17 (the
+        default) doubles are written with the fewest digits that read back
+        as the same value.
 
     You can examine 'settings_` yourself
     to see the defaults. You can also write and read them just like any
@@ -135,6 +139,57 @@ public:
   static void setDefaults(Json::Value* settings);
 };
 
+/** \brief Write a Value into a caller-owned buffer, without streams.
+
+The text is appended to the buffer, so clearing and reusing one buffer keeps
+its capacity from message to message. Without indentation the output is
+that of FastWriter (minus the ending line feed), produced by a separate
+path that tests no layout option per token. With indentation it is that of
+StreamWriterBuilder with "commentStyle" "None".
+
+Usage:
+\code
+  using namespace Json;
+  BufferWriter const writer;  // compact
+  std::string buffer;
+  for (...) {
+    buffer.clear();
+    writer.write(message, buffer);
+    send(buffer);
+  }
+\endcode
+*/
+class JSON_API BufferWriter {
+public:
+  /// Compact output, "null" for nullValues, full precision.
+  BufferWriter();
+  /** \param settings Same keys as StreamWriterBuilder::settings_; missing
+   * keys take the compact defaults and "commentStyle" is ignored.
+   */
+  explicit BufferWriter(const Value& settings);
+
+  /// Append the text of \c root to \c out.
+  void write(const Value& root, JSONCPP_STRING& out) const;
+  void write(const Value& root, std::vector<char>& out) const;
+
+private:
+  template <typename Buffer>
+  void writeCompact(const Value& value, Buffer& out) const;
+  template <typename Buffer>
+  void writeIndented(const Value& value, Buffer& out, unsigned depth,
+                     bool newLine) const;
+  template <typename Buffer>
+  void writeScalar(const Value& value, Buffer& out) const;
+  template <typename Buffer>
+  void writeIndent(Buffer& out, unsigned depth) const;
+
+  JSONCPP_STRING indentation_;
+  JSONCPP_STRING colonSymbol_;
+  JSONCPP_STRING nullSymbol_;
+  bool useSpecialFloats_;
+  unsigned int precision_;
+};
+
 /** \brief Abstract class for writers.
  * \deprecated Use StreamWriter. (And really, this is an implementation detail.)
  */
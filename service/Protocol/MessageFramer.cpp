@@ -0,0 +1,59 @@
+
+#include <algorithm>
+
+#include "MessageFramer.hpp"
+
+namespace service {
+
+message_framer::message_framer(std::size_t max_body_size)
+    : m_state(READ_HEAD),
+      m_max_body_size(max_body_size),
+      m_filled(0)
+{
+}
+
+void message_framer::reset()
+{
+    m_state = READ_HEAD;
+    m_filled = 0;
+}
+
+boost::tribool message_framer::parse(ring_buffer &in, hm_message &msg)
+{
+    for (;;)
+    {
+        switch (m_state)
+        {
+            case READ_HEAD:
+                if (in.size() < sizeof(msg.head))
+                    return boost::indeterminate;
+                in.peek(&msg.head, sizeof(msg.head));
+                if (msg.head.size > m_max_body_size)
+                    return false;
+                in.consume(sizeof(msg.head));
+                msg.body = buffer_pool::instance().allocate(msg.head.size);
+                m_filled = 0;
+                m_state = READ_BODY;
+                break;
+
+            case READ_BODY:
+            {
+                std::size_t n = std::min(msg.head.size - m_filled, in.size());
+                if (n)
+                {
+                    in.peek(msg.body.data() + m_filled, n);
+                    in.consume(n);
+                    m_filled += n;
+                }
+
+                if (m_filled < msg.head.size)
+                    return boost::indeterminate;
+
+                m_state = READ_HEAD;
+                return true;
+            }
+        }
+    }
+}
+
+} // service
@@ -0,0 +1,44 @@
+#ifndef MESSAGE_FRAMER_HPP
+#define MESSAGE_FRAMER_HPP
+
+#include <boost/logic/tribool.hpp>
+
+#include "Protocol.hpp"
+#include "RingBuffer.hpp"
+
+namespace service {
+
+/// Incremental hm_head+body framer fed from a connection's ring buffer.
+class message_framer
+{
+public:
+    /// Construct ready to parse frames whose body is at most max_body_size.
+    explicit message_framer(std::size_t max_body_size = HM_MAX_BODY_SIZE);
+
+    /// Reset to initial parser state.
+    void reset();
+
+    /// Try to extract the next frame from the buffered input. Returns true
+    /// when msg holds a complete frame, false when the stream is corrupt
+    /// (head.size exceeds the limit) and indeterminate when more data is
+    /// required. msg.body is a pooled buffer owned by msg.
+    boost::tribool parse(ring_buffer &in, hm_message &msg);
+
+    std::size_t max_body_size() const { return m_max_body_size; }
+
+private:
+    enum state
+    {
+        READ_HEAD,
+        READ_BODY
+    } m_state;
+
+    std::size_t m_max_body_size;
+
+    /// Body bytes of the current frame copied so far.
+    std::size_t m_filled;
+};
+
+} // service
+
+#endif // MESSAGE_FRAMER_HPP
@@ -15,12 +15,13 @@ void CNotify::Parse(const std::string &jsonstring)
 
 void CNotify::Dump()
 {
-    Json::Value::Members member(m_root.getMemberNames());
-    Json::Value memberVal;
-    for(Json::Value::Members::iterator it = member.begin(); it != member.end(); it ++ )
+    if(!m_root.isObject())
+        return;
+
+    // Walk the members in place: getMemberNames() would copy every key
+    for(Json::Value::const_iterator it = m_root.begin(); it != m_root.end(); it ++ )
     {
-        memberVal = m_root[*it];
-        std::cout << memberVal.toStyledString() << std::endl;
+        std::cout << it->toStyledString() << std::endl;
     }
 }
 
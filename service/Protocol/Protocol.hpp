@@ -4,6 +4,24 @@
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
 
+#include "BufferPool.hpp"
+
+/// Default upper bound accepted for hm_head::size.
+#define HM_MAX_BODY_SIZE     (1024 * 1024)
+
+/// Default per-connection receive ring size.
+#define HM_RECV_BUFFER_SIZE  (8 * 1024)
+
+/// Keep-alive frame, empty body, sent both ways and never dispatched.
+#define HM_CMD_HEARTBEAT     0
+
+/// Values of hm_head::error.
+enum hm_error
+{
+    HM_OK = 0,
+    HM_ERROR_UNKNOWN_CMD = 1
+};
+
 struct hm_head 
 {
     unsigned int cmd;
@@ -15,7 +33,7 @@ struct hm_head
 struct hm_message
 {
     hm_head head;
-    char *body;
+    service::pooled_buffer body;    /* head.size bytes, shared on copy */
 };
 
 #endif /* PROTOCOL_HPP */
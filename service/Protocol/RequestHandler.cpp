@@ -1,19 +1,56 @@
 
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <boost/lexical_cast.hpp>
 
 #include "RequestHandler.hpp"
 
 namespace service {
+
+/// Command ids above this are rejected rather than growing the table.
+static const unsigned int max_command_id = 0xFFFF;
+
 request_handler::request_handler()
 {
 }
 
-void request_handler::handle_request(const hm_message& req, hm_message& rep)
+void request_handler::register_handler(unsigned int cmd, const command_handler &handler)
 {
+    if (cmd > max_command_id)
+        throw std::out_of_range("command id " + 
+            boost::lexical_cast<std::string>(cmd) + " out of range");
+    if (cmd == HM_CMD_HEARTBEAT)
+        throw std::invalid_argument("command id " +
+            boost::lexical_cast<std::string>(cmd) + " is the heartbeat");
+
+    if (cmd >= m_handlers.size())
+        m_handlers.resize(cmd + 1);
+    m_handlers[cmd] = handler;
 }
 
+void request_handler::unregister_handler(unsigned int cmd)
+{
+    if (cmd < m_handlers.size())
+        m_handlers[cmd].clear();
 }
 
+void request_handler::handle_request(const hm_message& req, const reply_callback &reply)
+{
+    unsigned int cmd = req.head.cmd;
+    if (cmd < m_handlers.size() && m_handlers[cmd])
+    {
+        m_handlers[cmd](req, reply);
+        return;
+    }
+
+    hm_message rep;
+    rep.head.cmd = cmd;
+    rep.head.size = 0;
+    rep.head.error = HM_ERROR_UNKNOWN_CMD;
+    rep.head.session = req.head.session;
+    reply(rep);
+}
+
+}
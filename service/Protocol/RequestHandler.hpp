@@ -2,23 +2,48 @@
 #define REQUEST_HANDLER_HPP
 
 #include <string>
+#include <vector>
 #include <boost/asio.hpp>
+#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
 #include "Protocol.hpp"
 
 namespace service {
 
+/// Sends a reply for one request. May be copied, stored and called later
+/// from any thread; the reply goes out with the request's session.
+typedef boost::function<void(hm_message &rep)> reply_callback;
+
+/// Handler for one command id. Replying is optional and may happen after
+/// the handler has returned.
+typedef boost::function<void(const hm_message &req, 
+    const reply_callback &reply)> command_handler;
+
 /// The common handler for all incoming requests.
-class request_handler
+class request_handler : private boost::noncopyable
 {
 public:
     explicit request_handler();
 
-    void handle_request(const hm_message& req, hm_message& rep);
+    /// Install handler for cmd, replacing any previous one. Registration
+    /// is not synchronised with dispatch; do it before the server runs.
+    /// HM_CMD_HEARTBEAT is consumed by the connection and cannot be
+    /// registered.
+    void register_handler(unsigned int cmd, const command_handler &handler);
+
+    /// Remove the handler for cmd.
+    void unregister_handler(unsigned int cmd);
+
+    /// Dispatch req to the handler registered for req.head.cmd; unknown
+    /// commands are answered with HM_ERROR_UNKNOWN_CMD.
+    void handle_request(const hm_message& req, const reply_callback &reply);
+
+private:
+    /// Handlers indexed directly by command id.
+    std::vector<command_handler> m_handlers;
 };
 
 } // service
 
 #endif // REQUEST_HANDLER_HPP
-
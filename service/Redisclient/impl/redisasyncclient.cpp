@@ -45,6 +45,11 @@ bool RedisAsyncClient::isConnected() const
             pimpl->getState() == RedisClientImpl::Subscribed;
 }
 
+bool RedisAsyncClient::isSubscribed() const
+{
+    return pimpl->getState() == RedisClientImpl::Subscribed;
+}
+
 
 void RedisAsyncClient::disconnect()
 {
@@ -57,186 +62,149 @@ void RedisAsyncClient::installErrorHandler(
     pimpl->errorHandler = handler;
 }
 
-void RedisAsyncClient::command(const std::string &s, const boost::function<void(const RedisValue &)> &handler)
+void RedisAsyncClient::installCloseHandler(const boost::function<void()> &handler)
 {
-    if(stateValid())
-    {
-        std::vector<RedisBuffer> items(1);
-        items[0] = s;
+    pimpl->closeHandler = handler;
+}
 
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl, 
-                    pimpl->makeCommand(items), handler));
-    }
+void RedisAsyncClient::setPipelineLimit(size_t bytes)
+{
+    pimpl->pipelineLimit = bytes;
 }
 
-void RedisAsyncClient::command(const std::string &cmd, const RedisBuffer &arg1,
-                          const boost::function<void(const RedisValue &)> &handler)
+void RedisAsyncClient::setCommandTimeout(const boost::posix_time::time_duration &timeout)
 {
-    if(stateValid())
-    {
-        std::vector<RedisBuffer> items(2);
-        items[0] = cmd;
-        items[1] = arg1;
+    pimpl->commandTimeout = timeout.total_microseconds();
+}
 
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
-    }
+void RedisAsyncClient::setMaxPending(size_t commands)
+{
+    pimpl->maxPending = commands;
 }
 
-void RedisAsyncClient::command(const std::string &cmd, const RedisBuffer &arg1,
-                          const RedisBuffer &arg2,
-                          const boost::function<void(const RedisValue &)> &handler)
+void RedisAsyncClient::fulfil(const boost::shared_ptr<std::promise<RedisValue> > &promise,
+                              const ReplyHandler &handler, const RedisValue &value)
 {
-    if(stateValid())
-    {
-        std::vector<RedisBuffer> items(3);
-        items[0] = cmd;
-        items[1] = arg1;
-        items[2] = arg2;
+    if( handler )
+        handler(value);
 
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
-    }
+    promise->set_value(value);
 }
 
-void RedisAsyncClient::command(const std::string &cmd, const RedisBuffer &arg1,
-                          const RedisBuffer &arg2, const RedisBuffer &arg3,
+void RedisAsyncClient::command(const std::string &cmd, const std::vector<RedisSlice> &args,
                           const boost::function<void(const RedisValue &)> &handler)
 {
     if(stateValid())
     {
-        std::vector<RedisBuffer> items(4);
+        std::vector<RedisBuffer> items(1);
         items[0] = cmd;
-        items[1] = arg1;
-        items[2] = arg2;
-        items[3] = arg3;
 
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl, 
-                    pimpl->makeCommand(items), handler));
+        items.insert(items.end(), args.begin(), args.end());
+        pimpl->asyncCommand(&items[0], items.size(), handler);
     }
 }
 
-void RedisAsyncClient::command(const std::string &cmd, const RedisBuffer &arg1,
-                          const RedisBuffer &arg2, const RedisBuffer &arg3,
-                          const RedisBuffer &arg4,
+void RedisAsyncClient::command(const std::string &cmd, const std::list<RedisBuffer> &args,
                           const boost::function<void(const RedisValue &)> &handler)
 {
     if(stateValid())
     {
-        std::vector<RedisBuffer> items(5);
+        std::vector<RedisBuffer> items(1);
         items[0] = cmd;
-        items[1] = arg1;
-        items[2] = arg2;
-        items[3] = arg3;
-        items[4] = arg4;
 
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
+        items.reserve(1 + args.size());
+
+        std::copy(args.begin(), args.end(), std::back_inserter(items));
+        pimpl->asyncCommand(&items[0], items.size(), handler);
     }
 }
 
-void RedisAsyncClient::command(const std::string &cmd, const RedisBuffer &arg1,
-                          const RedisBuffer &arg2, const RedisBuffer &arg3,
-                          const RedisBuffer &arg4, const RedisBuffer &arg5,
-                          const boost::function<void(const RedisValue &)> &handler)
+RedisAsyncClient::Handle RedisAsyncClient::subscribe(
+        const std::string &channel,
+        const boost::function<void(const std::vector<char> &msg, const std::string &channel)> &msgHandler,
+        const boost::function<void(const RedisValue &)> &handler)
 {
-    if(stateValid())
-    {
-        std::vector<RedisBuffer> items(6);
-        items[0] = cmd;
-        items[1] = arg1;
-        items[2] = arg2;
-        items[3] = arg3;
-        items[4] = arg4;
-        items[5] = arg5;
-
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
-    }
+    static const std::string subscribeStr = "SUBSCRIBE";
+
+    return doSubscribe(subscribeStr, channel,
+                       boost::bind(&RedisClientImpl::addMsgHandler, pimpl, false, channel,
+                                   _1, msgHandler),
+                       handler);
 }
 
-void RedisAsyncClient::command(const std::string &cmd, const RedisBuffer &arg1,
-                          const RedisBuffer &arg2, const RedisBuffer &arg3,
-                          const RedisBuffer &arg4, const RedisBuffer &arg5,
-                          const RedisBuffer &arg6,
-                          const boost::function<void(const RedisValue &)> &handler)
+RedisAsyncClient::Handle RedisAsyncClient::subscribeSlice(
+        const std::string &channel,
+        const boost::function<void(const RedisSlice &msg, const std::string &channel)> &msgHandler,
+        const boost::function<void(const RedisValue &)> &handler)
 {
-    if(stateValid())
-    {
-        std::vector<RedisBuffer> items(7);
-        items[0] = cmd;
-        items[1] = arg1;
-        items[2] = arg2;
-        items[3] = arg3;
-        items[4] = arg4;
-        items[5] = arg5;
-        items[6] = arg6;
-
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
-    }
+    static const std::string subscribeStr = "SUBSCRIBE";
+
+    return doSubscribe(subscribeStr, channel,
+                       boost::bind(&RedisClientImpl::addSliceHandler, pimpl, false, channel,
+                                   _1, msgHandler),
+                       handler);
 }
 
-void RedisAsyncClient::command(const std::string &cmd, const RedisBuffer &arg1,
-                          const RedisBuffer &arg2, const RedisBuffer &arg3,
-                          const RedisBuffer &arg4, const RedisBuffer &arg5,
-                          const RedisBuffer &arg6, const RedisBuffer &arg7,
-                          const boost::function<void(const RedisValue &)> &handler)
+RedisAsyncClient::Handle RedisAsyncClient::psubscribe(
+        const std::string &pattern,
+        const boost::function<void(const std::vector<char> &msg, const std::string &channel)> &msgHandler,
+        const boost::function<void(const RedisValue &)> &handler)
 {
-    if(stateValid())
-    {
-        std::vector<RedisBuffer> items(8);
-        items[0] = cmd;
-        items[1] = arg1;
-        items[2] = arg2;
-        items[3] = arg3;
-        items[4] = arg4;
-        items[5] = arg5;
-        items[6] = arg6;
-        items[7] = arg7;
-
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
-    }
+    static const std::string psubscribeStr = "PSUBSCRIBE";
+
+    return doSubscribe(psubscribeStr, pattern,
+                       boost::bind(&RedisClientImpl::addMsgHandler, pimpl, true, pattern,
+                                   _1, msgHandler),
+                       handler);
 }
 
-void RedisAsyncClient::command(const std::string &cmd, const std::list<RedisBuffer> &args,
-                          const boost::function<void(const RedisValue &)> &handler)
+RedisAsyncClient::Handle RedisAsyncClient::psubscribeSlice(
+        const std::string &pattern,
+        const boost::function<void(const RedisSlice &msg, const std::string &channel)> &msgHandler,
+        const boost::function<void(const RedisValue &)> &handler)
 {
-    if(stateValid())
-    {
-        std::vector<RedisBuffer> items(1);
-        items[0] = cmd;
+    static const std::string psubscribeStr = "PSUBSCRIBE";
 
-        items.reserve(1 + args.size());
+    return doSubscribe(psubscribeStr, pattern,
+                       boost::bind(&RedisClientImpl::addSliceHandler, pimpl, true, pattern,
+                                   _1, msgHandler),
+                       handler);
+}
 
-        std::copy(args.begin(), args.end(), std::back_inserter(items));
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
-    }
+void RedisAsyncClient::unsubscribe(const Handle &handle)
+{
+    static const std::string unsubscribeStr = "UNSUBSCRIBE";
+
+    doUnsubscribe(unsubscribeStr, false, handle);
 }
 
-RedisAsyncClient::Handle RedisAsyncClient::subscribe(
-        const std::string &channel,
-        const boost::function<void(const std::vector<char> &msg, const std::string &channel)> &msgHandler,
+void RedisAsyncClient::punsubscribe(const Handle &handle)
+{
+    static const std::string punsubscribeStr = "PUNSUBSCRIBE";
+
+    doUnsubscribe(punsubscribeStr, true, handle);
+}
+
+RedisAsyncClient::Handle RedisAsyncClient::doSubscribe(
+        const std::string &cmd, const std::string &name,
+        const boost::function<void(size_t id)> &addHandler,
         const boost::function<void(const RedisValue &)> &handler)
 {
     assert( pimpl->state == RedisClientImpl::Connected ||
             pimpl->state == RedisClientImpl::Subscribed);
 
-    static const std::string subscribeStr = "SUBSCRIBE";
-
     if( pimpl->state == RedisClientImpl::Connected || pimpl->state == RedisClientImpl::Subscribed )
     {
-        Handle handle = {pimpl->subscribeSeq++, channel};
+        Handle handle = {pimpl->subscribeSeq++, name};
 
-        std::vector<RedisBuffer> items(2);
-        items[0] = subscribeStr;
-        items[1] = channel;
+        RedisBuffer items[2];
+        items[0] = cmd;
+        items[1] = name;
 
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
-        pimpl->msgHandlers.insert(std::make_pair(channel, std::make_pair(handle.id, msgHandler)));
+        // Handlers are only touched on the strand, where messages are
+        // dispatched; registering first also orders it before the command.
+        pimpl->strand.dispatch(boost::bind(addHandler, handle.id));
+        pimpl->asyncCommand(items, 2, handler);
         pimpl->state = RedisClientImpl::Subscribed;
 
         return handle;
@@ -253,7 +221,7 @@ RedisAsyncClient::Handle RedisAsyncClient::subscribe(
     }
 }
 
-void RedisAsyncClient::unsubscribe(const Handle &handle)
+void RedisAsyncClient::doUnsubscribe(const std::string &cmd, bool pattern, const Handle &handle)
 {
 #ifdef DEBUG
     static int recursion = 0;
@@ -263,34 +231,19 @@ void RedisAsyncClient::unsubscribe(const Handle &handle)
     assert( pimpl->state == RedisClientImpl::Connected ||
             pimpl->state == RedisClientImpl::Subscribed);
 
-    static const std::string unsubscribeStr = "UNSUBSCRIBE";
-
     if( pimpl->state == RedisClientImpl::Connected ||
             pimpl->state == RedisClientImpl::Subscribed )
     {
         // Remove subscribe-handler
-        typedef RedisClientImpl::MsgHandlersMap::iterator iterator;
-        std::pair<iterator, iterator> pair = pimpl->msgHandlers.equal_range(handle.channel);
-
-        for(iterator it = pair.first; it != pair.second;)
-        {
-            if( it->second.first == handle.id )
-            {
-                pimpl->msgHandlers.erase(it++);
-            }
-            else
-            {
-                ++it;
-            }
-        }
-
-        std::vector<RedisBuffer> items(2);
-        items[0] = unsubscribeStr;
+        pimpl->strand.dispatch(boost::bind(&RedisClientImpl::removeMsgHandler, pimpl,
+                                           pattern, handle.channel, handle.id));
+
+        RedisBuffer items[2];
+        items[0] = cmd;
         items[1] = handle.channel;
 
         // Unsubscribe command for Redis
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), dummyHandler));
+        pimpl->asyncCommand(items, 2, dummyHandler);
     }
     else
     {
@@ -323,13 +276,13 @@ void RedisAsyncClient::singleShotSubscribe(const std::string &channel,
     if( pimpl->state == RedisClientImpl::Connected ||
             pimpl->state == RedisClientImpl::Subscribed )
     {
-        std::vector<RedisBuffer> items(2);
+        RedisBuffer items[2];
         items[0] = subscribeStr;
         items[1] = channel;
 
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
-        pimpl->singleShotMsgHandlers.insert(std::make_pair(channel, msgHandler));
+        pimpl->strand.dispatch(boost::bind(&RedisClientImpl::addSingleShotHandler, pimpl,
+                                           channel, msgHandler));
+        pimpl->asyncCommand(items, 2, handler);
         pimpl->state = RedisClientImpl::Subscribed;
     }
     else
@@ -353,14 +306,13 @@ void RedisAsyncClient::publish(const std::string &channel, const RedisBuffer &ms
 
     if( pimpl->state == RedisClientImpl::Connected )
     {
-        std::vector<RedisBuffer> items(3);
+        RedisBuffer items[3];
 
         items[0] = publishStr;
         items[1] = channel;
         items[2] = msg;
 
-        pimpl->post(boost::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), handler));
+        pimpl->asyncCommand(items, 3, handler);
     }
     else
     {
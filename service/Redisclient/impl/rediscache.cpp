@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCACHE_CPP
+#define REDISCLIENT_REDISCACHE_CPP
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
+
+#include "../rediscache.h"
+#include "../redisasyncclient.h"
+
+namespace {
+
+bool commandIs(const RedisBuffer &buf, const char *name)
+{
+    size_t len = strlen(name);
+
+    if( buf.size() != len )
+        return false;
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        if( (buf.data()[i] & ~0x20) != name[i] )
+            return false;
+    }
+
+    return true;
+}
+
+}
+
+RedisReadCache::RedisReadCache(size_t maxBytes, time_t ttl)
+    : maxBytes(maxBytes), ttl(ttl), bytes(0), invalidationEpoch(0)
+{
+    memset(&counters, 0, sizeof(counters));
+    memset(keyEpochs, 0, sizeof(keyEpochs));
+}
+
+void RedisReadCache::track(RedisAsyncClient &client, int db)
+{
+    boost::weak_ptr<RedisReadCache> self(shared_from_this());
+
+    client.installCloseHandler(boost::bind(&RedisReadCache::onTrackClosed, self));
+
+    if( client.isSubscribed() )
+    {
+        // The server refuses CONFIG in subscribe mode; an earlier
+        // track() on this client has already checked it.
+        subscribeKeyspace(self, client, db);
+        return;
+    }
+
+    client.command("CONFIG", "GET", "notify-keyspace-events",
+                   boost::bind(&RedisReadCache::onTrackConfig, self, &client, db, _1));
+}
+
+void RedisReadCache::untrack()
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    tracked.clear();
+    ++invalidationEpoch;
+    clear();
+}
+
+bool RedisReadCache::isTracking() const
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    return tracked.empty() == false;
+}
+
+bool RedisReadCache::notifiesKeyspace(const RedisValue &config)
+{
+    if( config.isArray() == false || config.getArray().size() != 2 )
+        return false;
+
+    std::string flags = config.getArray()[1].toString();
+
+    if( flags.find('K') == std::string::npos )
+        return false;
+
+    if( flags.find('A') != std::string::npos )
+        return true;
+
+    // Generic (DEL, RENAME...), string, hash, expired and evicted events
+    for(const char *c = "g$hxe"; *c; ++c)
+    {
+        if( flags.find(*c) == std::string::npos )
+            return false;
+    }
+
+    return true;
+}
+
+void RedisReadCache::subscribeKeyspace(const boost::weak_ptr<RedisReadCache> &cache,
+                                       RedisAsyncClient &client, int db)
+{
+    std::stringstream ss;
+
+    ss << "__keyspace@" << db << "__:";
+
+    std::string prefix = ss.str();
+
+    client.psubscribe(prefix + "*",
+                      boost::bind(&RedisReadCache::onNotification, cache, db, prefix.size(), _2),
+                      boost::bind(&RedisReadCache::onTrackAck, cache, db, _1));
+}
+
+void RedisReadCache::onTrackConfig(const boost::weak_ptr<RedisReadCache> &cache,
+                                   RedisAsyncClient *client, int db, const RedisValue &value)
+{
+    boost::shared_ptr<RedisReadCache> self = cache.lock();
+
+    if( !self || value.isError() || notifiesKeyspace(value) == false )
+        return;
+
+    subscribeKeyspace(cache, *client, db);
+}
+
+void RedisReadCache::onTrackClosed(const boost::weak_ptr<RedisReadCache> &cache)
+{
+    boost::shared_ptr<RedisReadCache> self = cache.lock();
+
+    if( self )
+        self->untrack();
+}
+
+void RedisReadCache::onTrackAck(const boost::weak_ptr<RedisReadCache> &cache,
+                                int db, const RedisValue &value)
+{
+    boost::shared_ptr<RedisReadCache> self = cache.lock();
+
+    if( !self || value.isError() )
+        return;
+
+    boost::mutex::scoped_lock lock(self->mutex);
+
+    self->tracked.insert(db);
+}
+
+void RedisReadCache::onNotification(const boost::weak_ptr<RedisReadCache> &cache,
+                                    int db, size_t prefixSize, const std::string &channel)
+{
+    boost::shared_ptr<RedisReadCache> self = cache.lock();
+
+    if( !self || channel.size() < prefixSize )
+        return;
+
+    std::string key = makeKey(db, channel.data() + prefixSize, channel.size() - prefixSize);
+
+    boost::mutex::scoped_lock lock(self->mutex);
+
+    self->invalidateKey(key);
+}
+
+bool RedisReadCache::cacheable(const std::vector<RedisBuffer> &items)
+{
+    switch( items.size() )
+    {
+        case 2:
+            return commandIs(items[0], "GET") || commandIs(items[0], "HGETALL");
+        case 3:
+            return commandIs(items[0], "HGET");
+        default:
+            return false;
+    }
+}
+
+bool RedisReadCache::selects(const std::vector<RedisBuffer> &items, int &db)
+{
+    if( items.size() != 2 || commandIs(items[0], "SELECT") == false )
+        return false;
+
+    db = atoi(std::string(items[1].data(), items[1].size()).c_str());
+    return true;
+}
+
+std::string RedisReadCache::makeId(int db, const std::vector<RedisBuffer> &items)
+{
+    // Arguments are binary: prefix each one with its length
+    std::string id(reinterpret_cast<const char *>(&db), sizeof(db));
+
+    for(size_t i = 0; i < items.size(); ++i)
+    {
+        size_t size = items[i].size();
+
+        id.append(reinterpret_cast<const char *>(&size), sizeof(size));
+
+        if( i == 0 )
+        {
+            for(size_t j = 0; j < size; ++j)
+                id.push_back(items[i].data()[j] & ~0x20);
+        }
+        else
+        {
+            id.append(items[i].data(), size);
+        }
+    }
+
+    return id;
+}
+
+std::string RedisReadCache::makeKey(int db, const char *key, size_t size)
+{
+    std::string name(reinterpret_cast<const char *>(&db), sizeof(db));
+
+    name.append(key, size);
+    return name;
+}
+
+size_t RedisReadCache::keyEpochSlot(const std::string &key)
+{
+    return boost::hash<std::string>()(key) % keyEpochSlots;
+}
+
+size_t RedisReadCache::valueSize(const RedisValue &value)
+{
+    size_t size = sizeof(RedisValue);
+
+    if( value.isByteArray() )
+    {
+        size += value.getByteArray().size();
+    }
+    else if( value.isArray() )
+    {
+        const std::vector<RedisValue> &array = value.getArray();
+
+        for(size_t i = 0; i < array.size(); ++i)
+            size += valueSize(array[i]);
+    }
+
+    return size;
+}
+
+bool RedisReadCache::lookup(int db, const std::vector<RedisBuffer> &items,
+                            RedisValue &value)
+{
+    std::string id = makeId(db, items);
+
+    boost::mutex::scoped_lock lock(mutex);
+
+    boost::unordered_map<std::string, EntryIterator>::iterator it = entries.find(id);
+
+    if( it == entries.end() )
+    {
+        ++counters.misses;
+        return false;
+    }
+
+    EntryIterator entry = it->second;
+
+    if( ttl != 0 && entry->expires <= time(NULL) )
+    {
+        ++counters.expirations;
+        ++counters.misses;
+        erase(entry);
+        return false;
+    }
+
+    // Move to the front of the LRU list
+    lru.splice(lru.begin(), lru, entry);
+
+    ++counters.hits;
+    value = entry->value;
+    return true;
+}
+
+uint64_t RedisReadCache::epoch(int db, const std::vector<RedisBuffer> &items) const
+{
+    if( items.size() < 2 )
+        return 0;
+
+    std::string key = makeKey(db, items[1].data(), items[1].size());
+
+    boost::mutex::scoped_lock lock(mutex);
+
+    return invalidationEpoch + keyEpochs[keyEpochSlot(key)];
+}
+
+void RedisReadCache::store(int db, const std::vector<RedisBuffer> &items,
+                           const RedisValue &value, uint64_t epoch)
+{
+    if( value.isError() || items.size() < 2 )
+        return;
+
+    Entry entry;
+
+    entry.id = makeId(db, items);
+    entry.key = makeKey(db, items[1].data(), items[1].size());
+    entry.value = value;
+    entry.bytes = sizeof(Entry) + entry.id.size() + entry.key.size() + valueSize(value);
+    entry.expires = ttl == 0 ? 0 : time(NULL) + ttl;
+
+    if( entry.bytes > maxBytes )
+        return;
+
+    boost::mutex::scoped_lock lock(mutex);
+
+    if( tracked.count(db) == 0 || epoch != invalidationEpoch + keyEpochs[keyEpochSlot(entry.key)] )
+        return;
+
+    boost::unordered_map<std::string, EntryIterator>::iterator it = entries.find(entry.id);
+
+    if( it != entries.end() )
+        erase(it->second);
+
+    while( bytes + entry.bytes > maxBytes && lru.empty() == false )
+    {
+        ++counters.evictions;
+        erase(--lru.end());
+    }
+
+    bytes += entry.bytes;
+    lru.push_front(Entry());
+    lru.front().id.swap(entry.id);
+    lru.front().key.swap(entry.key);
+    lru.front().value.swap(entry.value);
+    lru.front().bytes = entry.bytes;
+    lru.front().expires = entry.expires;
+
+    entries[lru.front().id] = lru.begin();
+    keys[lru.front().key].push_back(lru.begin());
+}
+
+void RedisReadCache::invalidate(int db, const RedisBuffer &key)
+{
+    std::string name = makeKey(db, key.data(), key.size());
+
+    boost::mutex::scoped_lock lock(mutex);
+
+    invalidateKey(name);
+}
+
+void RedisReadCache::invalidateAll()
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    ++invalidationEpoch;
+    counters.invalidations += lru.size();
+    clear();
+}
+
+void RedisReadCache::invalidateFor(int db, const std::vector<RedisBuffer> &items)
+{
+    if( items.empty() )
+        return;
+
+    if( commandIs(items[0], "FLUSHDB") || commandIs(items[0], "FLUSHALL") )
+    {
+        invalidateAll();
+        return;
+    }
+
+    std::vector<std::string> names;
+
+    names.reserve(items.size() - 1);
+
+    for(size_t i = 1; i < items.size(); ++i)
+        names.push_back(makeKey(db, items[i].data(), items[i].size()));
+
+    boost::mutex::scoped_lock lock(mutex);
+
+    // Any argument may be a key; a spurious invalidation only costs a read.
+    // Done even with no entries, to turn away fills already under way.
+    for(size_t i = 0; i < names.size(); ++i)
+        invalidateKey(names[i]);
+}
+
+RedisReadCache::Stats RedisReadCache::stats() const
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    Stats result = counters;
+
+    result.entries = lru.size();
+    result.bytes = bytes;
+    return result;
+}
+
+void RedisReadCache::erase(EntryIterator it)
+{
+    boost::unordered_map<std::string, std::vector<EntryIterator> >::iterator k = keys.find(it->key);
+
+    if( k != keys.end() )
+    {
+        std::vector<EntryIterator> &list = k->second;
+
+        list.erase(std::find(list.begin(), list.end(), it));
+
+        if( list.empty() )
+            keys.erase(k);
+    }
+
+    entries.erase(it->id);
+    bytes -= it->bytes;
+    lru.erase(it);
+}
+
+void RedisReadCache::invalidateKey(const std::string &key)
+{
+    ++keyEpochs[keyEpochSlot(key)];
+
+    boost::unordered_map<std::string, std::vector<EntryIterator> >::iterator k = keys.find(key);
+
+    if( k == keys.end() )
+        return;
+
+    std::vector<EntryIterator> list;
+
+    list.swap(k->second);
+    keys.erase(k);
+
+    for(size_t i = 0; i < list.size(); ++i)
+    {
+        entries.erase(list[i]->id);
+        bytes -= list[i]->bytes;
+        lru.erase(list[i]);
+    }
+
+    counters.invalidations += list.size();
+}
+
+void RedisReadCache::clear()
+{
+    lru.clear();
+    entries.clear();
+    keys.clear();
+    bytes = 0;
+}
+
+#endif // REDISCLIENT_REDISCACHE_CPP
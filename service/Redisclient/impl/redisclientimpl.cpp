@@ -8,15 +8,19 @@
 
 #include <boost/asio/write.hpp>
 #include <boost/bind.hpp>
-#include <boost/lexical_cast.hpp>
 
 #include <algorithm>
 #include <iostream>
+#include <string.h>
+#include <time.h>
 
 #include "redisclientimpl.h"
 
 RedisClientImpl::RedisClientImpl(boost::asio::io_service &ioService)
-    : strand(ioService), socket(ioService), subscribeSeq(0), state(NotConnected)
+    : strand(ioService), socket(ioService),
+      buf(readBufferMin), lastFullRead(0), subscribeSeq(0),
+      commandSeq(0), pendingCount(0), maxPending(0), commandTimeout(0), deadlineTimer(ioService),
+      writeOffset(0), writeInFlight(0), pipelineLimit(64 * 1024), state(NotConnected)
 {
 }
 
@@ -30,13 +34,21 @@ void RedisClientImpl::close()
     if( state != RedisClientImpl::Closed )
     {
         boost::system::error_code ignored_ec;
+        bool established = state == RedisClientImpl::Connected ||
+                state == RedisClientImpl::Subscribed;
 
-        msgHandlers.clear();
+        channels.clear();
+        patterns.clear();
+
+        failPending("ERR connection closed");
 
         socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
         socket.close(ignored_ec);
 
         state = RedisClientImpl::Closed;
+
+        if( established && closeHandler )
+            closeHandler();
     }
 }
 
@@ -49,51 +61,70 @@ void RedisClientImpl::processMessage()
 {
     using boost::system::error_code;
 
+    size_t pending = redisParser.bulkPending();
+
+    if( pending > buf.size() )
+    {
+        // Rest of a large bulk string: read it straight into the value
+        // the parser is building instead of through buf.
+        pending = std::min<size_t>(pending, readBufferMax);
+        socket.async_read_some(boost::asio::buffer(redisParser.bulkTail(pending), pending),
+                               strand.wrap(boost::bind(&RedisClientImpl::asyncReadBulk,
+                                                       this, _1, _2)));
+        return;
+    }
+
     socket.async_read_some(boost::asio::buffer(buf),
-                           boost::bind(&RedisClientImpl::asyncRead,
-                                       this, _1, _2));
+                           strand.wrap(boost::bind(&RedisClientImpl::asyncRead,
+                                                   this, _1, _2)));
 }
 
-void RedisClientImpl::doProcessMessage(const RedisValue &v)
+void RedisClientImpl::adaptReadBuffer(size_t bytesRead)
+{
+    time_t now = time(0);
+
+    if( bytesRead == buf.size() )
+    {
+        // The read filled the buffer: more data is probably waiting
+        lastFullRead = now;
+
+        if( buf.size() < readBufferMax )
+            std::vector<char>(std::min<size_t>(buf.size() * 2, readBufferMax)).swap(buf);
+    }
+    else if( buf.size() > readBufferMin && now - lastFullRead >= readBufferShrinkDelay )
+    {
+        // No full read for a while: give back half, one step per period
+        lastFullRead = now;
+        std::vector<char>(std::max<size_t>(buf.size() / 2, readBufferMin)).swap(buf);
+    }
+}
+
+void RedisClientImpl::doProcessMessage(RedisValue &v)
 {
     if( state == RedisClientImpl::Subscribed )
     {
-        std::vector<RedisValue> result = v.toArray();
+        static const std::vector<RedisValue> empty;
+        const std::vector<RedisValue> &result = v.isArray() ? v.getArray() : empty;
 
         if( result.size() == 3 )
         {
             const RedisValue &command = result[0];
             const RedisValue &queueName = result[1];
-            const RedisValue &value = result[2];
 
             const std::string &cmd = command.toString();
 
             if( cmd == "message" )
             {
-                SingleShotHandlersMap::iterator it = singleShotMsgHandlers.find(queueName.toString());
-                if( it != singleShotMsgHandlers.end() )
-                {
-                    strand.post(boost::bind(it->second, value.toByteArray()));
-                    singleShotMsgHandlers.erase(it);
-                }
+                Subscription *subscription = queueName.isByteArray() ?
+                        channels.find(queueName.getByteArray()) : 0;
 
-                std::pair<MsgHandlersMap::iterator, MsgHandlersMap::iterator> pair =
-                        msgHandlers.equal_range(queueName.toString());
-                for(MsgHandlersMap::iterator handlerIt = pair.first;
-                    handlerIt != pair.second; ++handlerIt)
-                {
-                    strand.post(boost::bind(handlerIt->second.second, value.toByteArray(), queueName.toString()));
-                }
-            }
-            else if( cmd == "subscribe" && handlers.empty() == false )
-            {
-                handlers.front()(v);
-                handlers.pop();
+                if( subscription )
+                    dispatchMessage(subscription, v.getArray()[2], subscription->name);
             }
-            else if(cmd == "unsubscribe" && handlers.empty() == false )
+            else if( (cmd == "subscribe" || cmd == "unsubscribe" || cmd == "psubscribe" || cmd == "punsubscribe") &&
+                     handlers.empty() == false )
             {
-                handlers.front()(v);
-                handlers.pop();
+                completeCommand(v);
             }
             else
             {
@@ -106,13 +137,24 @@ void RedisClientImpl::doProcessMessage(const RedisValue &v)
                 return;
             }
         }
+        else if( result.size() == 4 && result[0].toString() == "pmessage" )
+        {
+            const RedisValue &pattern = result[1];
+            Subscription *subscription = pattern.isByteArray() ?
+                    patterns.find(pattern.getByteArray()) : 0;
+
+            if( subscription )
+            {
+                SharedChannel channel(new std::string(result[2].toString()));
+                dispatchMessage(subscription, v.getArray()[3], channel);
+            }
+        }
         else if (result.size() >= 0)
         {
             // Sub client result of running command
             if( handlers.empty() == false )
             {
-                handlers.front()(v);
-                handlers.pop();
+                completeCommand(v);
             }
             else
             {
@@ -136,8 +178,7 @@ void RedisClientImpl::doProcessMessage(const RedisValue &v)
     {
         if( handlers.empty() == false )
         {
-            handlers.front()(v);
-            handlers.pop();
+            completeCommand(v);
         }
         else
         {
@@ -152,25 +193,245 @@ void RedisClientImpl::doProcessMessage(const RedisValue &v)
     }
 }
 
+void RedisClientImpl::dispatchMessage(Subscription *subscription, RedisValue &value,
+                                      const SharedChannel &channel)
+{
+    // Move the payload out of the parsed reply once; every handler then
+    // gets a reference to the same buffer.
+    boost::shared_ptr<std::vector<char> > payload(new std::vector<char>());
+
+    if( value.isByteArray() )
+        payload->swap(value.getByteArray());
+
+    for(size_t i = 0; i < subscription->singleShotHandlers.size(); ++i)
+    {
+        strand.post(boost::bind(&RedisClientImpl::deliverSingleShot,
+                                subscription->singleShotHandlers[i],
+                                SharedPayload(payload)));
+    }
+
+    for(size_t i = 0; i < subscription->msgHandlers.size(); ++i)
+    {
+        strand.post(boost::bind(&RedisClientImpl::deliverMessage,
+                                subscription->msgHandlers[i].second,
+                                SharedPayload(payload), channel));
+    }
+
+    for(size_t i = 0; i < subscription->sliceHandlers.size(); ++i)
+    {
+        strand.post(boost::bind(&RedisClientImpl::deliverSlice,
+                                subscription->sliceHandlers[i].second,
+                                SharedPayload(payload), channel));
+    }
+
+    if( subscription->singleShotHandlers.empty() == false )
+    {
+        subscription->singleShotHandlers.clear();
+
+        if( subscription->msgHandlers.empty() && subscription->sliceHandlers.empty() )
+            channels.release(*subscription->name);
+    }
+}
+
+void RedisClientImpl::addMsgHandler(bool pattern, const std::string &name, size_t id,
+                                    const MsgHandlerType::second_type &handler)
+{
+    (pattern ? patterns : channels).intern(name).msgHandlers.push_back(
+            MsgHandlerType(id, handler));
+}
+
+void RedisClientImpl::addSliceHandler(bool pattern, const std::string &name, size_t id,
+                                      const SliceHandlerType::second_type &handler)
+{
+    (pattern ? patterns : channels).intern(name).sliceHandlers.push_back(
+            SliceHandlerType(id, handler));
+}
+
+void RedisClientImpl::addSingleShotHandler(const std::string &name,
+                                           const SingleShotHandlerType &handler)
+{
+    channels.intern(name).singleShotHandlers.push_back(handler);
+}
+
+void RedisClientImpl::removeMsgHandler(bool pattern, const std::string &name, size_t id)
+{
+    SubscriptionTable &table = pattern ? patterns : channels;
+    Subscription *subscription = table.find(name);
+
+    if( subscription )
+    {
+        std::vector<MsgHandlerType> &msgHandlers = subscription->msgHandlers;
+        std::vector<SliceHandlerType> &sliceHandlers = subscription->sliceHandlers;
+
+        for(size_t i = 0; i < msgHandlers.size();)
+        {
+            if( msgHandlers[i].first == id )
+                msgHandlers.erase(msgHandlers.begin() + i);
+            else
+                ++i;
+        }
+
+        for(size_t i = 0; i < sliceHandlers.size();)
+        {
+            if( sliceHandlers[i].first == id )
+                sliceHandlers.erase(sliceHandlers.begin() + i);
+            else
+                ++i;
+        }
+
+        table.release(name);
+    }
+}
+
+RedisClientImpl::Subscription *RedisClientImpl::SubscriptionTable::find(const std::vector<char> &name)
+{
+    boost::unordered_map<std::string, size_t, NameHash, NameEqual>::iterator it =
+            ids.find(name, NameHash(), NameEqual());
+
+    return it == ids.end() ? 0 : &slots[it->second];
+}
+
+RedisClientImpl::Subscription *RedisClientImpl::SubscriptionTable::find(const std::string &name)
+{
+    boost::unordered_map<std::string, size_t, NameHash, NameEqual>::iterator it = ids.find(name);
+
+    return it == ids.end() ? 0 : &slots[it->second];
+}
+
+RedisClientImpl::Subscription &RedisClientImpl::SubscriptionTable::intern(const std::string &name)
+{
+    boost::unordered_map<std::string, size_t, NameHash, NameEqual>::iterator it = ids.find(name);
+
+    if( it != ids.end() )
+        return slots[it->second];
+
+    size_t id;
+
+    if( freeSlots.empty() == false )
+    {
+        id = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        id = slots.size();
+        slots.resize(id + 1);
+    }
+
+    ids.insert(std::make_pair(name, id));
+    slots[id].name.reset(new std::string(name));
+
+    return slots[id];
+}
+
+void RedisClientImpl::SubscriptionTable::release(const std::string &name)
+{
+    boost::unordered_map<std::string, size_t, NameHash, NameEqual>::iterator it = ids.find(name);
+
+    if( it == ids.end() )
+        return;
+
+    Subscription &subscription = slots[it->second];
+
+    if( subscription.msgHandlers.empty() && subscription.sliceHandlers.empty() &&
+        subscription.singleShotHandlers.empty() )
+    {
+        // name may refer to subscription.name; drop the map entry first
+        size_t id = it->second;
+
+        ids.erase(it);
+        subscription.name.reset();
+        freeSlots.push_back(id);
+    }
+}
+
+void RedisClientImpl::SubscriptionTable::clear()
+{
+    ids.clear();
+    slots.clear();
+    freeSlots.clear();
+}
+
+void RedisClientImpl::deliverMessage(
+        const boost::function<void(const std::vector<char> &, const std::string &)> &handler,
+        const SharedPayload &payload, const SharedChannel &channel)
+{
+    handler(*payload, *channel);
+}
+
+void RedisClientImpl::deliverSlice(
+        const boost::function<void(const RedisSlice &, const std::string &)> &handler,
+        const SharedPayload &payload, const SharedChannel &channel)
+{
+    handler(RedisSlice(payload), *channel);
+}
+
+void RedisClientImpl::deliverSingleShot(
+        const boost::function<void(const std::vector<char> &)> &handler,
+        const SharedPayload &payload)
+{
+    handler(*payload);
+}
+
+void RedisClientImpl::startWrite()
+{
+    assert( writeInFlight == 0 && commandSizes.empty() == false );
+
+    if( writeOffset == writeBuffer.size() )
+    {
+        writeBuffer.clear();
+        writeBuffer.swap(outBuffer);
+        writeOffset = 0;
+    }
+
+    // commandSizes runs on into outBuffer; one write never crosses into it.
+    size_t available = writeBuffer.size() - writeOffset;
+
+    while( commandSizes.empty() == false )
+    {
+        size_t size = commandSizes.front();
+
+        if( writeInFlight + size > available )
+            break;
+
+        if( writeInFlight != 0 && (pipelineLimit == 0 || writeInFlight + size > pipelineLimit) )
+            break;
+
+        writeInFlight += size;
+        commandSizes.pop_front();
+    }
+
+    boost::asio::async_write(socket,
+                             boost::asio::buffer(&writeBuffer[writeOffset], writeInFlight),
+                             strand.wrap(boost::bind(&RedisClientImpl::asyncWrite, this, _1, _2)));
+}
+
 void RedisClientImpl::asyncWrite(const boost::system::error_code &ec, const size_t)
 {
     if( ec )
     {
+        // No write is in flight any more. Unwritten commands would
+        // otherwise go out after a reconnect with no handler left for
+        // their replies.
+        outBuffer.clear();
+        writeBuffer.clear();
+        writeOffset = 0;
+        writeInFlight = 0;
+        commandSizes.clear();
+
+        // Aborted by close(), which has failed the pending commands itself
+        if( ec != boost::asio::error::operation_aborted )
+            connectionLost("ERR connection lost");
+
         errorHandler(ec.message());
         return;
     }
 
-    assert(queue.empty() == false);
-    queue.pop();
+    writeOffset += writeInFlight;
+    writeInFlight = 0;
 
-    if( queue.empty() == false )
-    {
-        const QueueItem &item = queue.front();
-        
-        boost::asio::async_write(socket,
-                                 boost::asio::buffer(item.buff->data(), item.buff->size()),
-                                 boost::bind(&RedisClientImpl::asyncWrite, this, _1, _2));
-    }
+    if( commandSizes.empty() == false )
+        startWrite();
 }
 
 void RedisClientImpl::handleAsyncConnect(const boost::system::error_code &ec,
@@ -189,24 +450,79 @@ void RedisClientImpl::handleAsyncConnect(const boost::system::error_code &ec,
     }
 }
 
-std::vector<char> RedisClientImpl::makeCommand(const std::vector<RedisBuffer> &items)
+namespace {
+
+inline size_t decimalLength(size_t value)
 {
-    static const char crlf[] = {'\r', '\n'};
+    size_t n = 1;
 
-    std::vector<char> result;
+    for(; value >= 10; value /= 10)
+        ++n;
+
+    return n;
+}
+
+inline char *formatDecimal(char *out, size_t value)
+{
+    size_t n = decimalLength(value);
+    char *end = out + n;
+
+    do {
+        *--end = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while( value != 0 );
+
+    return out + n;
+}
+
+} // namespace
+
+size_t RedisClientImpl::commandSize(const RedisBuffer *items, size_t count)
+{
+    // *<count>\r\n then $<size>\r\n<data>\r\n per item
+    size_t size = 1 + decimalLength(count) + 2;
+
+    for(size_t i = 0; i < count; ++i)
+        size += 1 + decimalLength(items[i].size()) + 2 + items[i].size() + 2;
+
+    return size;
+}
+
+char *RedisClientImpl::encodeCommand(char *out, const RedisBuffer *items, size_t count)
+{
+    *out++ = '*';
+    out = formatDecimal(out, count);
+    *out++ = '\r';
+    *out++ = '\n';
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        *out++ = '$';
+        out = formatDecimal(out, items[i].size());
+        *out++ = '\r';
+        *out++ = '\n';
+
+        if( items[i].size() != 0 )
+        {
+            memcpy(out, items[i].data(), items[i].size());
+            out += items[i].size();
+        }
 
-    append(result, '*');
-    append(result, boost::lexical_cast<std::string>(items.size()));
-    append<>(result, crlf);
+        *out++ = '\r';
+        *out++ = '\n';
+    }
+
+    return out;
+}
 
-    std::vector<RedisBuffer>::const_iterator it = items.begin(), end = items.end();
-    for(; it != end; ++it)
+std::vector<char> RedisClientImpl::makeCommand(const std::vector<RedisBuffer> &items)
+{
+    std::vector<char> result;
+
+    if( items.empty() == false )
     {
-        append(result, '$');
-        append(result, boost::lexical_cast<std::string>(it->size()));
-        append<>(result, crlf);
-        append(result, *it);
-        append<>(result, crlf);
+        result.resize(commandSize(&items[0], items.size()));
+        encodeCommand(&result[0], &items[0], items.size());
     }
 
     return result;
@@ -214,14 +530,16 @@ std::vector<char> RedisClientImpl::makeCommand(const std::vector<RedisBuffer> &i
 
 RedisValue RedisClientImpl::doSyncCommand(const std::vector<RedisBuffer> &buff)
 {
-    assert( queue.empty() );
+    assert( writeInFlight == 0 && commandSizes.empty() );
 
     boost::system::error_code ec;
 
-
+    if( buff.empty() == false )
     {
-        std::vector<char> data = makeCommand(buff);
-        boost::asio::write(socket, boost::asio::buffer(data), boost::asio::transfer_all(), ec);
+        outBuffer.resize(commandSize(&buff[0], buff.size()));
+        encodeCommand(&outBuffer[0], &buff[0], buff.size());
+        boost::asio::write(socket, boost::asio::buffer(outBuffer), boost::asio::transfer_all(), ec);
+        outBuffer.clear();
     }
 
     if( ec )
@@ -231,19 +549,29 @@ RedisValue RedisClientImpl::doSyncCommand(const std::vector<RedisBuffer> &buff)
     }
     else
     {
-        boost::array<char, 4096> inbuff;
-
         for(;;)
         {
-            size_t size = socket.read_some(boost::asio::buffer(inbuff));
+            size_t pending = redisParser.bulkPending();
+
+            if( pending > buf.size() )
+            {
+                pending = std::min<size_t>(pending, readBufferMax);
+                size_t size = socket.read_some(boost::asio::buffer(redisParser.bulkTail(pending), pending));
+                redisParser.commitBulk(size);
+                continue;
+            }
+
+            size_t size = socket.read_some(boost::asio::buffer(buf));
 
             for(size_t pos = 0; pos < size;)
             {
                 std::pair<size_t, RedisParser::ParseResult> result = 
-                    redisParser.parse(inbuff.data() + pos, size - pos);
+                    redisParser.parse(&buf[pos], size - pos);
 
                 if( result.second == RedisParser::Completed )
                 {
+                    // Only once the bytes are parsed: this may replace buf
+                    adaptReadBuffer(size);
                     return redisParser.result();
                 }
                 else if( result.second == RedisParser::Incompleted )
@@ -257,52 +585,256 @@ RedisValue RedisClientImpl::doSyncCommand(const std::vector<RedisBuffer> &buff)
                     return RedisValue();
                 }
             }
+
+            adaptReadBuffer(size);
+        }
+    }
+}
+
+void RedisClientImpl::asyncCommand(const RedisBuffer *items, size_t count,
+                                   const boost::function<void(const RedisValue &)> &handler,
+                                   const boost::posix_time::ptime &deadline)
+{
+    size_t limit = maxPending.load(std::memory_order_relaxed);
+
+    if( pendingCount.fetch_add(1) >= limit && limit != 0 )
+    {
+        // Overloaded: fail now rather than queue behind a stalled server
+        --pendingCount;
+        post(boost::bind(handler, errorValue("ERR too many pending commands")));
+        return;
+    }
+
+    boost::posix_time::ptime due = deadline;
+    int64_t timeout = commandTimeout.load(std::memory_order_relaxed);
+
+    if( due.is_not_a_date_time() && timeout > 0 )
+        due = boost::posix_time::microsec_clock::universal_time() +
+              boost::posix_time::microseconds(timeout);
+
+    if( strand.running_in_this_thread() )
+    {
+        doAsyncCommand(items, count, handler, due);
+    }
+    else
+    {
+        // Arguments are not owned by RedisBuffer, so encode them before
+        // leaving the caller's thread.
+        boost::shared_ptr<std::vector<char> > buff(
+                new std::vector<char>(commandSize(items, count)));
+
+        encodeCommand(&(*buff)[0], items, count);
+
+        void (RedisClientImpl::*queueEncoded)(
+                const boost::shared_ptr<std::vector<char> > &,
+                const boost::function<void(const RedisValue &)> &,
+                const boost::posix_time::ptime &) = &RedisClientImpl::doAsyncCommand;
+
+        post(boost::bind(queueEncoded, this, buff, handler, due));
+    }
+}
+
+void RedisClientImpl::doAsyncCommand(const RedisBuffer *items, size_t count,
+                                     const boost::function<void(const RedisValue &)> &handler,
+                                     const boost::posix_time::ptime &deadline)
+{
+    if( refuseClosed(handler) )
+        return;
+
+    size_t size = commandSize(items, count);
+    size_t offset = outBuffer.size();
+
+    outBuffer.resize(offset + size);
+    encodeCommand(&outBuffer[offset], items, count);
+    commandSizes.push_back(size);
+
+    queueHandler(handler, deadline);
+
+    // Commands queued while a write is in flight go out together
+    // in the next one; replies are matched FIFO through handlers.
+    if( writeInFlight == 0 )
+        startWrite();
+}
+
+void RedisClientImpl::doAsyncCommand(const boost::shared_ptr<std::vector<char> > &buff,
+                                     const boost::function<void(const RedisValue &)> &handler,
+                                     const boost::posix_time::ptime &deadline)
+{
+    if( refuseClosed(handler) )
+        return;
+
+    outBuffer.insert(outBuffer.end(), buff->begin(), buff->end());
+    commandSizes.push_back(buff->size());
+
+    queueHandler(handler, deadline);
+
+    if( writeInFlight == 0 )
+        startWrite();
+}
+
+bool RedisClientImpl::refuseClosed(const boost::function<void(const RedisValue &)> &handler)
+{
+    if( state != RedisClientImpl::Closed )
+        return false;
+
+    // Queued from another thread before the connection went away
+    --pendingCount;
+
+    if( handler )
+        post(boost::bind(handler, errorValue("ERR connection closed")));
+
+    return true;
+}
+
+void RedisClientImpl::queueHandler(const boost::function<void(const RedisValue &)> &handler,
+                                   const boost::posix_time::ptime &deadline)
+{
+    PendingCommand command;
+
+    command.seq = commandSeq++;
+    handlers.push_back(command);
+    handlers.back().handler = handler;
+
+    if( deadline.is_not_a_date_time() == false )
+    {
+        deadlines.push(Deadline(deadline, command.seq));
+        armDeadlineTimer();
+    }
+}
+
+void RedisClientImpl::completeCommand(const RedisValue &v)
+{
+    // Pop first: the handler may queue further commands
+    boost::function<void(const RedisValue &)> handler;
+
+    handler.swap(handlers.front().handler);
+    handlers.pop_front();
+    --pendingCount;
+
+    if( handlers.empty() && deadlines.empty() == false )
+    {
+        // Every deadline left belongs to an answered command
+        boost::system::error_code ignored_ec;
+
+        deadlines = std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> >();
+        deadlineArmed = boost::posix_time::ptime();
+        deadlineTimer.cancel(ignored_ec);
+    }
+
+    if( handler )
+        handler(v);
+}
+
+void RedisClientImpl::armDeadlineTimer()
+{
+    if( deadlines.empty() || deadlines.top().first == deadlineArmed )
+        return;
+
+    deadlineArmed = deadlines.top().first;
+    deadlineTimer.expires_at(deadlineArmed);
+    deadlineTimer.async_wait(strand.wrap(boost::bind(&RedisClientImpl::onDeadline,
+                                                     this, _1)));
+}
+
+void RedisClientImpl::onDeadline(const boost::system::error_code &ec)
+{
+    if( ec )
+        return;
+
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+    deadlineArmed = boost::posix_time::ptime();
+
+    while( deadlines.empty() == false && deadlines.top().first <= now )
+    {
+        uint64_t seq = deadlines.top().second;
+
+        deadlines.pop();
+
+        if( handlers.empty() || seq < handlers.front().seq ||
+            seq - handlers.front().seq >= handlers.size() )
+        {
+            continue;
         }
+
+        // Fail the command now; its slot stays queued for the late reply
+        boost::function<void(const RedisValue &)> handler;
+
+        handler.swap(handlers[seq - handlers.front().seq].handler);
+
+        if( handler )
+            handler(errorValue("ERR command timed out"));
     }
+
+    armDeadlineTimer();
 }
 
-void RedisClientImpl::doAsyncCommand(const std::vector<char> &buff,
-                                     const boost::function<void(const RedisValue &)> &handler)
+void RedisClientImpl::failPending(const std::string &message)
 {
-    QueueItem item;
+    // Swap out first: a handler may queue further commands
+    std::deque<PendingCommand> failed;
+    boost::system::error_code ignored_ec;
+
+    failed.swap(handlers);
 
-    item.buff.reset( new std::vector<char>(buff) );
-    item.handler = handler;
-    queue.push(item);
+    deadlines = std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> >();
+    deadlineArmed = boost::posix_time::ptime();
+    deadlineTimer.cancel(ignored_ec);
 
-    handlers.push( item.handler );
+    pendingCount -= failed.size();
 
-    if( queue.size() == 1 )
+    RedisValue error = errorValue(message);
+
+    for(size_t i = 0; i < failed.size(); ++i)
     {
-        boost::asio::async_write(socket, 
-                                 boost::asio::buffer(item.buff->data(), item.buff->size()),
-                                 boost::bind(&RedisClientImpl::asyncWrite, this, _1, _2));
+        if( failed[i].handler )
+            post(boost::bind(failed[i].handler, error));
     }
 }
 
+void RedisClientImpl::connectionLost(const std::string &message)
+{
+    failPending(message);
+
+    // Refuse further commands; closing the socket also aborts a write in
+    // flight, whose completion then drops the unwritten commands.
+    close();
+}
+
+RedisValue RedisClientImpl::errorValue(const std::string &message)
+{
+    RedisValue::ErrorTag tag;
+
+    return RedisValue(std::vector<char>(message.begin(), message.end()), tag);
+}
+
 void RedisClientImpl::asyncRead(const boost::system::error_code &ec, const size_t size)
 {
     if( ec || size == 0 )
     {
+        if( ec != boost::asio::error::operation_aborted )
+            connectionLost("ERR connection lost");
+
         errorHandler(ec.message());
         return;
     }
 
     for(size_t pos = 0; pos < size;)
     {
-        std::pair<size_t, RedisParser::ParseResult> result = redisParser.parse(buf.data() + pos, size - pos);
+        std::pair<size_t, RedisParser::ParseResult> result = redisParser.parse(&buf[pos], size - pos);
 
         if( result.second == RedisParser::Completed )
         {
-            doProcessMessage(redisParser.result());
+            RedisValue value = redisParser.result();
+            doProcessMessage(value);
         }
         else if( result.second == RedisParser::Incompleted )
         {
-            processMessage();
-            return;
+            break;
         }
         else
         {
+            connectionLost("ERR protocol error");
             errorHandler("[RedisClient] Parser error");
             return;
         }
@@ -310,8 +842,23 @@ void RedisClientImpl::asyncRead(const boost::system::error_code &ec, const size_
         pos += result.first;
     }
 
+    adaptReadBuffer(size);
     processMessage();
+}
+
+void RedisClientImpl::asyncReadBulk(const boost::system::error_code &ec, const size_t size)
+{
+    if( ec || size == 0 )
+    {
+        if( ec != boost::asio::error::operation_aborted )
+            connectionLost("ERR connection lost");
+
+        errorHandler(ec.message());
+        return;
+    }
 
+    redisParser.commitBulk(size);
+    processMessage();
 }
 
 void RedisClientImpl::onRedisError(const RedisValue &v)
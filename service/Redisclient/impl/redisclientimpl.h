@@ -6,20 +6,29 @@
 #ifndef REDISCLIENT_REDISCLIENTIMPL_H
 #define REDISCLIENT_REDISCLIENTIMPL_H
 
-#include <boost/array.hpp>
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/strand.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <string>
+#include <time.h>
 #include <vector>
 #include <queue>
-#include <map>
+#include <deque>
 
 #include "../redisparser.h"
 #include "../redisbuffer.h"
+#include "../redisslice.h"
 #include "../config.h"
 
 class RedisClientImpl {
@@ -44,17 +53,58 @@ public:
 
     REDIS_CLIENT_DECL static std::vector<char> makeCommand(const std::vector<RedisBuffer> &items);
 
+    // Exact size of the RESP encoding of a command.
+    REDIS_CLIENT_DECL static size_t commandSize(const RedisBuffer *items, size_t count);
+    // Encode a command into out, which must hold commandSize() bytes.
+    // Returns the end of the written data.
+    REDIS_CLIENT_DECL static char *encodeCommand(char *out, const RedisBuffer *items, size_t count);
+
     REDIS_CLIENT_DECL RedisValue doSyncCommand(const std::vector<RedisBuffer> &buff);
 
+    // Queue a command from any thread. Inside the strand it is encoded
+    // straight into outBuffer; otherwise it is encoded once here and
+    // handed to the strand. Without a deadline commandTimeout applies.
+    // Fails the command at once when maxPending commands are waiting.
+    REDIS_CLIENT_DECL void asyncCommand(
+            const RedisBuffer *items, size_t count,
+            const boost::function<void(const RedisValue &)> &handler,
+            const boost::posix_time::ptime &deadline = boost::posix_time::ptime());
+
     REDIS_CLIENT_DECL void doAsyncCommand(
-            const std::vector<char> &buff,
-            const boost::function<void(const RedisValue &)> &handler);
+            const RedisBuffer *items, size_t count,
+            const boost::function<void(const RedisValue &)> &handler,
+            const boost::posix_time::ptime &deadline);
+    REDIS_CLIENT_DECL void doAsyncCommand(
+            const boost::shared_ptr<std::vector<char> > &buff,
+            const boost::function<void(const RedisValue &)> &handler,
+            const boost::posix_time::ptime &deadline);
+
+    REDIS_CLIENT_DECL void queueHandler(
+            const boost::function<void(const RedisValue &)> &handler,
+            const boost::posix_time::ptime &deadline);
+    // Pop the oldest pending command and pass it its reply.
+    REDIS_CLIENT_DECL void completeCommand(const RedisValue &v);
+    REDIS_CLIENT_DECL void armDeadlineTimer();
+    REDIS_CLIENT_DECL void onDeadline(const boost::system::error_code &ec);
+    // Fail every command awaiting a reply with message. The write state
+    // is left to asyncWrite(), as a write may still be in flight.
+    REDIS_CLIENT_DECL void failPending(const std::string &message);
+    // Read, write or protocol error: fail the pending commands and close.
+    REDIS_CLIENT_DECL void connectionLost(const std::string &message);
+    // Fail a command that reached the strand after close().
+    REDIS_CLIENT_DECL bool refuseClosed(const boost::function<void(const RedisValue &)> &handler);
+
+    // Error value handed to handlers of commands that got no reply.
+    REDIS_CLIENT_DECL static RedisValue errorValue(const std::string &message);
 
     REDIS_CLIENT_DECL void sendNextCommand();
+    REDIS_CLIENT_DECL void startWrite();
     REDIS_CLIENT_DECL void processMessage();
-    REDIS_CLIENT_DECL void doProcessMessage(const RedisValue &v);
+    REDIS_CLIENT_DECL void doProcessMessage(RedisValue &v);
     REDIS_CLIENT_DECL void asyncWrite(const boost::system::error_code &ec, const size_t);
     REDIS_CLIENT_DECL void asyncRead(const boost::system::error_code &ec, const size_t);
+    REDIS_CLIENT_DECL void asyncReadBulk(const boost::system::error_code &ec, const size_t);
+    REDIS_CLIENT_DECL void adaptReadBuffer(size_t bytesRead);
 
     REDIS_CLIENT_DECL void onRedisError(const RedisValue &);
     REDIS_CLIENT_DECL void defaulErrorHandler(const std::string &s);
@@ -69,30 +119,159 @@ public:
     template<typename Handler>
     inline void post(const Handler &handler);
 
+    // Published payload and channel name shared by every handler of a message.
+    typedef boost::shared_ptr<const std::vector<char> > SharedPayload;
+    typedef boost::shared_ptr<const std::string> SharedChannel;
+
+    REDIS_CLIENT_DECL static void deliverMessage(
+            const boost::function<void(const std::vector<char> &, const std::string &)> &handler,
+            const SharedPayload &payload, const SharedChannel &channel);
+    REDIS_CLIENT_DECL static void deliverSlice(
+            const boost::function<void(const RedisSlice &, const std::string &)> &handler,
+            const SharedPayload &payload, const SharedChannel &channel);
+    REDIS_CLIENT_DECL static void deliverSingleShot(
+            const boost::function<void(const std::vector<char> &)> &handler,
+            const SharedPayload &payload);
+
     boost::asio::strand strand;
     boost::asio::ip::tcp::socket socket;
     RedisParser redisParser;
-    boost::array<char, 4096> buf;
+
+    // Receive buffer: doubles (up to readBufferMax) whenever a read fills
+    // it and halves back towards readBufferMin once no read has filled it
+    // for readBufferShrinkDelay seconds.
+    std::vector<char> buf;
+    time_t lastFullRead;
+
+    enum {
+        readBufferMin = 4096,
+        readBufferMax = 1024 * 1024,
+        readBufferShrinkDelay = 30
+    };
     size_t subscribeSeq;
 
     typedef std::pair<size_t, boost::function<void(const std::vector<char> &buf, const std::string &channel)> > MsgHandlerType;
+    typedef std::pair<size_t, boost::function<void(const RedisSlice &msg, const std::string &channel)> > SliceHandlerType;
     typedef boost::function<void(const std::vector<char> &buf)> SingleShotHandlerType;
 
-    typedef std::multimap<std::string, MsgHandlerType> MsgHandlersMap;
-    typedef std::multimap<std::string, SingleShotHandlerType> SingleShotHandlersMap;
+    // Handlers of one channel or pattern. The name is interned once and
+    // shared with every delivery.
+    struct Subscription {
+        SharedChannel name;
+        std::vector<MsgHandlerType> msgHandlers;
+        std::vector<SliceHandlerType> sliceHandlers;
+        std::vector<SingleShotHandlerType> singleShotHandlers;
+    };
+
+    // Hashes names given as std::string or as the raw bytes of a reply
+    // the same way, so dispatch can look up without building a string.
+    struct NameHash {
+        size_t operator()(const std::string &s) const
+        {
+            return boost::hash_range(s.begin(), s.end());
+        }
+
+        size_t operator()(const std::vector<char> &s) const
+        {
+            return boost::hash_range(s.begin(), s.end());
+        }
+    };
 
-    std::queue<boost::function<void(const RedisValue &v)> > handlers;
-    MsgHandlersMap msgHandlers;
-    SingleShotHandlersMap singleShotMsgHandlers;
+    struct NameEqual {
+        bool operator()(const std::string &a, const std::string &b) const
+        {
+            return a == b;
+        }
 
-    struct QueueItem {
-        boost::function<void(const RedisValue &)> handler;
-        boost::shared_ptr<std::vector<char> > buff;
+        bool operator()(const std::vector<char> &a, const std::string &b) const
+        {
+            return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+        }
     };
 
-    std::queue<QueueItem> queue;
+    // Channel (or pattern) names interned to slots of a vector: a message
+    // costs one hash lookup however many channels are subscribed.
+    class SubscriptionTable {
+    public:
+        // Slot of name, or null.
+        REDIS_CLIENT_DECL Subscription *find(const std::vector<char> &name);
+        REDIS_CLIENT_DECL Subscription *find(const std::string &name);
+        // Slot of name, created if needed.
+        REDIS_CLIENT_DECL Subscription &intern(const std::string &name);
+        // Free the slot of name if it has no handlers left.
+        REDIS_CLIENT_DECL void release(const std::string &name);
+        REDIS_CLIENT_DECL void clear();
+
+        size_t size() const { return ids.size(); }
+
+    private:
+        boost::unordered_map<std::string, size_t, NameHash, NameEqual> ids;
+        std::vector<Subscription> slots;
+        std::vector<size_t> freeSlots;
+    };
+
+    REDIS_CLIENT_DECL void addMsgHandler(bool pattern, const std::string &name, size_t id,
+                                         const MsgHandlerType::second_type &handler);
+    REDIS_CLIENT_DECL void addSliceHandler(bool pattern, const std::string &name, size_t id,
+                                           const SliceHandlerType::second_type &handler);
+    REDIS_CLIENT_DECL void addSingleShotHandler(const std::string &name,
+                                                const SingleShotHandlerType &handler);
+    REDIS_CLIENT_DECL void removeMsgHandler(bool pattern, const std::string &name, size_t id);
+
+    REDIS_CLIENT_DECL void dispatchMessage(Subscription *subscription, RedisValue &payload,
+                                           const SharedChannel &channel);
+
+    // A command sent and awaiting its reply. The handler of a command that
+    // missed its deadline has already been called and is left empty: its
+    // reply is still read and dropped, which keeps replies and commands
+    // in step.
+    struct PendingCommand {
+        uint64_t seq;
+        boost::function<void(const RedisValue &v)> handler;
+    };
+
+    // Replies are matched FIFO; sequence numbers are consecutive.
+    std::deque<PendingCommand> handlers;
+    uint64_t commandSeq;
+
+    // Commands accepted and not yet answered, counted from any thread.
+    std::atomic<size_t> pendingCount;
+    // Set from any thread and read by asyncCommand(); the timeout is in
+    // microseconds.
+    std::atomic<size_t> maxPending;
+    std::atomic<int64_t> commandTimeout;
+
+    // Deadlines by time. Entries of commands already answered are dropped
+    // when they come due or when no command is pending.
+    typedef std::pair<boost::posix_time::ptime, uint64_t> Deadline;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> > deadlines;
+    boost::asio::deadline_timer deadlineTimer;
+    boost::posix_time::ptime deadlineArmed;
+
+    SubscriptionTable channels;
+    SubscriptionTable patterns;
+
+    // Encoded commands waiting for the socket. New commands are appended
+    // to outBuffer while writeBuffer is being written; the two are swapped
+    // when writeBuffer drains, so both keep their capacity.
+    std::vector<char> outBuffer;
+    std::vector<char> writeBuffer;
+    size_t writeOffset;
+    // Sizes of the commands in writeBuffer past writeOffset followed by
+    // those in outBuffer.
+    std::deque<size_t> commandSizes;
+
+    // Bytes covered by the write in progress.
+    size_t writeInFlight;
+    // Byte cap for gathering queued commands into one write; a command
+    // larger than the cap is still written on its own. Zero disables
+    // pipelining and writes one command at a time.
+    size_t pipelineLimit;
 
     boost::function<void(const std::string &)> errorHandler;
+    // Called once when an established connection is closed, whether
+    // by disconnect() or after an error.
+    boost::function<void()> closeHandler;
     State state;
 };
 
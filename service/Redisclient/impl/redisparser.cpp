@@ -12,7 +12,7 @@
 #include "../redisparser.h"
 
 RedisParser::RedisParser()
-    : state(Start), bulkSize(0)
+    : state(Start), bulkSize(0), bulkTailSize(0)
 {
 }
 
@@ -30,7 +30,10 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseArray(const char *
     assert( !valueStack.empty() );
 
     long int arraySize = arrayStack.top();
-    std::vector<RedisValue> arrayValue = valueStack.top().toArray();
+    std::vector<RedisValue> arrayValue;
+
+    // Take the partial array over instead of copying it on every resume
+    arrayValue.swap(valueStack.top().getArray());
 
     arrayStack.pop();
     valueStack.pop();
@@ -43,14 +46,15 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseArray(const char *
 
         if( pair.second != Completed )
         {
-            valueStack.push(arrayValue);
+            pushArray(arrayValue);
             arrayStack.push(arraySize);
 
             return pair;
         }
         else
         {
-            arrayValue.push_back( valueStack.top() );
+            arrayValue.push_back(RedisValue());
+            arrayValue.back().swap(valueStack.top());
             valueStack.pop();
             --arraySize;
         }
@@ -60,7 +64,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseArray(const char *
 
     if( i == size )
     {
-        valueStack.push(arrayValue);
+        pushArray(arrayValue);
 
         if( arraySize == 0 )
         {
@@ -88,7 +92,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseArray(const char *
         else if( pair.second == Incompleted )
         {
             arraySize -= x;
-            valueStack.push(arrayValue);
+            pushArray(arrayValue);
             arrayStack.push(arraySize);
 
             return std::make_pair(i, Incompleted);
@@ -96,14 +100,15 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseArray(const char *
         else
         {
             assert( valueStack.empty() == false );
-            arrayValue.push_back( valueStack.top() );
+            arrayValue.push_back(RedisValue());
+            arrayValue.back().swap(valueStack.top());
             valueStack.pop();
         }
     }
 
     assert( x == arraySize );
 
-    valueStack.push(arrayValue);
+    pushArray(arrayValue);
     return std::make_pair(i, Completed);
 }
 
@@ -247,14 +252,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                     }
                     else
                     {
-                        buf.reserve(bulkSize);
+                        buf.reserve(std::min<long int>(bulkSize, bulkReserveMax));
 
                         long int available = size - i - 1;
                         long int canRead = std::min(bulkSize, available);
 
                         if( canRead > 0 )
                         {
-                            buf.assign(ptr + i + 1, ptr + i + canRead + 1);
+                            buf.insert(buf.end(), ptr + i + 1, ptr + i + 1 + canRead);
                         }
 
                         i += canRead;
@@ -283,7 +288,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 long int available = size - i;
                 long int canRead = std::min(available, bulkSize);
 
-                buf.insert(buf.end(), ptr + i, ptr + canRead);
+                buf.insert(buf.end(), ptr + i, ptr + i + canRead);
                 bulkSize -= canRead;
                 i += canRead - 1;
 
@@ -317,7 +322,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 if( c == '\n')
                 {
                     state = Start;
-                    valueStack.push(buf);
+                    pushBytes(buf);
                     return std::make_pair(i + 1, Completed);
                 }
                 else
@@ -447,13 +452,54 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
     return std::make_pair(i, Incompleted);
 }
 
+size_t RedisParser::bulkPending() const
+{
+    return state == Bulk ? static_cast<size_t>(bulkSize) : 0;
+}
+
+char *RedisParser::bulkTail(size_t size)
+{
+    assert( state == Bulk && size > 0 && static_cast<long int>(size) <= bulkSize );
+
+    bulkTailSize = size;
+    buf.resize(buf.size() + size);
+
+    return &buf[buf.size() - size];
+}
+
+void RedisParser::commitBulk(size_t size)
+{
+    assert( state == Bulk && size <= bulkTailSize );
+
+    buf.resize(buf.size() - (bulkTailSize - size));
+    bulkTailSize = 0;
+    bulkSize -= size;
+
+    if( bulkSize == 0 )
+        state = BulkCR;
+}
+
+void RedisParser::pushBytes(std::vector<char> &bytes)
+{
+    valueStack.push(RedisValue(std::vector<char>()));
+    valueStack.top().getByteArray().swap(bytes);
+}
+
+void RedisParser::pushArray(std::vector<RedisValue> &array)
+{
+    valueStack.push(RedisValue(std::vector<RedisValue>()));
+    valueStack.top().getArray().swap(array);
+}
+
 RedisValue RedisParser::result()
 {
     assert( valueStack.empty() == false );
 
     if( valueStack.empty() == false )
     {
-        RedisValue value = valueStack.top();
+        RedisValue value;
+
+        value.swap(valueStack.top());
         valueStack.pop();
 
         return value;
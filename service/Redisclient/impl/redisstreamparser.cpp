@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISSTREAMPARSER_CPP
+#define REDISCLIENT_REDISSTREAMPARSER_CPP
+
+#include <string.h>
+#include <algorithm>
+
+#include "../redisstreamparser.h"
+
+RedisStreamParser::RedisStreamParser()
+    : state(Start), lineType(0), bulkSize(0)
+{
+}
+
+void RedisStreamParser::reset()
+{
+    state = Start;
+    bulkSize = 0;
+    spill.clear();
+    arrayStack.clear();
+}
+
+std::pair<size_t, RedisStreamParser::ParseResult> RedisStreamParser::parse(
+        const char *ptr, size_t size, RedisReplyVisitor &visitor)
+{
+    size_t i = 0;
+    bool completed = false;
+
+    while( i < size )
+    {
+        switch(state)
+        {
+            case Start:
+                lineType = ptr[i++];
+                switch(lineType)
+                {
+                    case stringReply:
+                    case errorReply:
+                    case integerReply:
+                    case bulkReply:
+                    case arrayReply:
+                        spill.clear();
+                        state = Line;
+                        break;
+                    default:
+                        reset();
+                        return std::make_pair(i, Error);
+                }
+                break;
+            case Line: {
+                const char *cr = static_cast<const char *>(memchr(ptr + i, '\r', size - i));
+
+                if( cr == 0 )
+                {
+                    spill.insert(spill.end(), ptr + i, ptr + size);
+                    i = size;
+                    break;
+                }
+
+                size_t n = cr - (ptr + i);
+
+                if( spill.empty() && cr + 1 != ptr + size )
+                {
+                    // Whole line is in the input: use it in place
+                    if( cr[1] != '\n' || !processLine(ptr + i, n, visitor, completed) )
+                    {
+                        reset();
+                        return std::make_pair(i + n + 2, Error);
+                    }
+
+                    i += n + 2;
+                }
+                else
+                {
+                    spill.insert(spill.end(), ptr + i, cr);
+                    i += n + 1;
+                    state = LineLF;
+                }
+                break;
+            }
+            case LineLF:
+                if( ptr[i++] != '\n' ||
+                    !processLine(spill.empty() ? 0 : &spill[0], spill.size(), visitor, completed) )
+                {
+                    reset();
+                    return std::make_pair(i, Error);
+                }
+                break;
+            case Bulk:
+                if( spill.empty() && size - i >= bulkSize + 2 )
+                {
+                    // Whole bulk string is in the input: report it in place
+                    if( ptr[i + bulkSize] != '\r' || ptr[i + bulkSize + 1] != '\n' )
+                    {
+                        reset();
+                        return std::make_pair(i + bulkSize + 2, Error);
+                    }
+
+                    visitor.onBulk(ptr + i, bulkSize);
+                    i += bulkSize + 2;
+                    state = Start;
+                    completed = valueCompleted(visitor);
+                }
+                else
+                {
+                    size_t n = std::min(bulkSize - spill.size(), size - i);
+
+                    spill.insert(spill.end(), ptr + i, ptr + i + n);
+                    i += n;
+
+                    if( spill.size() == bulkSize )
+                        state = BulkCR;
+                }
+                break;
+            case BulkCR:
+                if( ptr[i++] != '\r' )
+                {
+                    reset();
+                    return std::make_pair(i, Error);
+                }
+                state = BulkLF;
+                break;
+            case BulkLF:
+                if( ptr[i++] != '\n' )
+                {
+                    reset();
+                    return std::make_pair(i, Error);
+                }
+                visitor.onBulk(spill.empty() ? 0 : &spill[0], spill.size());
+                state = Start;
+                completed = valueCompleted(visitor);
+                break;
+        }
+
+        if( completed )
+            return std::make_pair(i, Completed);
+    }
+
+    return std::make_pair(i, Incompleted);
+}
+
+bool RedisStreamParser::processLine(const char *ptr, size_t size,
+                                    RedisReplyVisitor &visitor, bool &completed)
+{
+    int64_t value = 0;
+
+    state = Start;
+
+    switch(lineType)
+    {
+        case stringReply:
+            visitor.onString(ptr, size);
+            break;
+        case errorReply:
+            visitor.onError(ptr, size);
+            break;
+        case integerReply:
+            if( !parseInt(ptr, size, value) )
+                return false;
+            visitor.onInteger(value);
+            break;
+        case bulkReply:
+            if( !parseInt(ptr, size, value) || value < -1 )
+                return false;
+
+            if( value == -1 )
+            {
+                visitor.onNull();
+                break;
+            }
+
+            bulkSize = static_cast<size_t>(value);
+            spill.clear();
+            state = Bulk;
+            return true;
+        case arrayReply:
+            if( !parseInt(ptr, size, value) || value < -1 )
+                return false;
+
+            if( value == -1 )
+            {
+                visitor.onNull();
+                break;
+            }
+
+            visitor.onArrayBegin(static_cast<size_t>(value));
+
+            if( value == 0 )
+            {
+                visitor.onArrayEnd();
+                break;
+            }
+
+            arrayStack.push_back(value);
+            return true;
+        default:
+            return false;
+    }
+
+    completed = valueCompleted(visitor);
+    return true;
+}
+
+bool RedisStreamParser::valueCompleted(RedisReplyVisitor &visitor)
+{
+    while( !arrayStack.empty() )
+    {
+        if( --arrayStack.back() != 0 )
+            return false;
+
+        arrayStack.pop_back();
+        visitor.onArrayEnd();
+    }
+
+    return true;
+}
+
+bool RedisStreamParser::parseInt(const char *ptr, size_t size, int64_t &value)
+{
+    size_t i = 0;
+    bool negative = false;
+
+    if( size > 0 && ptr[0] == '-' )
+    {
+        negative = true;
+        ++i;
+    }
+
+    if( i == size || size - i > 19 )
+        return false;
+
+    uint64_t result = 0;
+
+    for(; i < size; ++i)
+    {
+        unsigned int digit = static_cast<unsigned char>(ptr[i]) - '0';
+
+        if( digit > 9 )
+            return false;
+
+        result = result * 10 + digit;
+    }
+
+    value = negative ? -static_cast<int64_t>(result) : static_cast<int64_t>(result);
+    return true;
+}
+
+void RedisReplyArena::clear()
+{
+    items.clear();
+    bytes.clear();
+}
+
+void RedisReplyArena::push(Type type, const char *ptr, size_t size, int64_t integer)
+{
+    Item item;
+
+    item.type = type;
+    item.offset = bytes.size();
+    item.size = size;
+    item.integer = integer;
+
+    if( type != Array && size != 0 )
+        bytes.insert(bytes.end(), ptr, ptr + size);
+
+    items.push_back(item);
+}
+
+void RedisReplyArena::onString(const char *ptr, size_t size)
+{
+    push(String, ptr, size, 0);
+}
+
+void RedisReplyArena::onError(const char *ptr, size_t size)
+{
+    push(Error, ptr, size, 0);
+}
+
+void RedisReplyArena::onInteger(int64_t value)
+{
+    push(Integer, 0, 0, value);
+}
+
+void RedisReplyArena::onBulk(const char *ptr, size_t size)
+{
+    push(Bulk, ptr, size, 0);
+}
+
+void RedisReplyArena::onNull()
+{
+    push(Null, 0, 0, 0);
+}
+
+void RedisReplyArena::onArrayBegin(size_t size)
+{
+    push(Array, 0, size, 0);
+}
+
+void RedisReplyArena::onArrayEnd()
+{
+}
+
+#endif // REDISCLIENT_REDISSTREAMPARSER_CPP
@@ -12,7 +12,7 @@
 #include "../redissyncclient.h"
 
 RedisSyncClient::RedisSyncClient(boost::asio::io_service &ioService)
-    : pimpl(boost::make_shared<RedisClientImpl>(boost::ref(ioService)))
+    : pimpl(boost::make_shared<RedisClientImpl>(boost::ref(ioService))), db(0)
 {
     pimpl->errorHandler = boost::bind(&RedisClientImpl::defaulErrorHandler,
                                       pimpl, _1);
@@ -43,6 +43,7 @@ bool RedisSyncClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
     if( !ec )
     {
         pimpl->state = RedisClientImpl::Connected;
+        db = 0;
         return true;
     }
     else
@@ -74,7 +75,7 @@ RedisValue RedisSyncClient::command(const std::string &s)
         std::vector<RedisBuffer> items(1);
         items[0] = s;
 
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -90,7 +91,7 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const RedisBuffer &a
         items[0] = cmd;
         items[1] = arg1;
 
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -108,7 +109,7 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const RedisBuffer &a
         items[1] = arg1;
         items[2] = arg2; 
 
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -127,7 +128,7 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const RedisBuffer &a
         items[2] = arg2;
         items[3] = arg3;
 
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -148,7 +149,7 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const RedisBuffer &a
         items[3] = arg3;
         items[4] = arg4;
 
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -170,7 +171,7 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const RedisBuffer &a
         items[4] = arg4;
         items[5] = arg5;
 
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -194,7 +195,7 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const RedisBuffer &a
         items[5] = arg5;
         items[6] = arg6;
 
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -219,7 +220,7 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const RedisBuffer &a
         items[6] = arg6;
         items[7] = arg7;
 
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -237,7 +238,7 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const std::list<std:
         items.reserve(1 + args.size());
 
         std::copy(args.begin(), args.end(), std::back_inserter(items));
-        return pimpl->doSyncCommand(items);
+        return execute(items);
     }
     else
     {
@@ -245,6 +246,48 @@ RedisValue RedisSyncClient::command(const std::string &cmd, const std::list<std:
     }
 }
 
+void RedisSyncClient::setCache(const boost::shared_ptr<RedisReadCache> &cache)
+{
+    this->cache = cache;
+}
+
+RedisValue RedisSyncClient::execute(const std::vector<RedisBuffer> &items)
+{
+    int selected;
+
+    if( RedisReadCache::selects(items, selected) )
+    {
+        RedisValue value = pimpl->doSyncCommand(items);
+
+        if( value.isOk() )
+            db = selected;
+
+        return value;
+    }
+
+    if( !cache )
+        return pimpl->doSyncCommand(items);
+
+    if( RedisReadCache::cacheable(items) )
+    {
+        RedisValue value;
+
+        if( cache->lookup(db, items, value) )
+            return value;
+
+        uint64_t epoch = cache->epoch(db, items);
+
+        value = pimpl->doSyncCommand(items);
+        cache->store(db, items, value, epoch);
+        return value;
+    }
+
+    // Reads its own writes without waiting for the notification
+    cache->invalidateFor(db, items);
+
+    return pimpl->doSyncCommand(items);
+}
+
 bool RedisSyncClient::stateValid() const
 {
     assert( pimpl->state == RedisClientImpl::Connected );
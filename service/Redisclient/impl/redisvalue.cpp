@@ -7,6 +7,7 @@
 #define REDISCLIENT_REDISVALUE_CPP
 
 #include <string.h>
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
 #include "../redisvalue.h"
 
@@ -61,6 +62,32 @@ std::vector<char> RedisValue::toByteArray() const
     return castTo<std::vector<char> >();
 }
 
+const std::vector<char> &RedisValue::getByteArray() const
+{
+    return boost::get<std::vector<char> >(value);
+}
+
+std::vector<char> &RedisValue::getByteArray()
+{
+    return boost::get<std::vector<char> >(value);
+}
+
+const std::vector<RedisValue> &RedisValue::getArray() const
+{
+    return boost::get<std::vector<RedisValue> >(value);
+}
+
+std::vector<RedisValue> &RedisValue::getArray()
+{
+    return boost::get<std::vector<RedisValue> >(value);
+}
+
+void RedisValue::swap(RedisValue &other)
+{
+    value.swap(other.value);
+    std::swap(error, other.error);
+}
+
 int64_t RedisValue::toInt() const
 {
     return castTo<int64_t>();
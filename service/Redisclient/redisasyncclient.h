@@ -7,21 +7,38 @@
 #define REDISASYNCCLIENT_REDISCLIENT_H
 
 #include <boost/asio/io_service.hpp>
+#include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/type_traits/integral_constant.hpp>
+#include <boost/type_traits/is_convertible.hpp>
+#include <boost/utility/enable_if.hpp>
 
+#include <future>
 #include <string>
 #include <list>
 
 #include "impl/redisclientimpl.h"
 #include "redisvalue.h"
 #include "redisbuffer.h"
+#include "redisslice.h"
 #include "config.h"
 
 class RedisClientImpl;
 
 class RedisAsyncClient {
 public:
+    // True for arguments meant for the std::list overload of command().
+    template<typename ...Args>
+    struct IsArgList : boost::false_type {};
+
+    template<typename ...Rest>
+    struct IsArgList<std::list<RedisBuffer>, Rest...> : boost::true_type {};
+
+    template<typename ...Rest>
+    struct IsArgList<std::vector<RedisSlice>, Rest...> : boost::true_type {};
+
     // Subscribe handle.
     struct Handle {
         size_t id;
@@ -62,68 +79,64 @@ public:
     // return true if is connected to redis
     REDIS_CLIENT_DECL bool isConnected() const;
 
-    // disconnect from redis and clear command queue
+    // return true if the connection is in subscribe mode
+    REDIS_CLIENT_DECL bool isSubscribed() const;
+
+    // disconnect from redis and clear command queue; commands awaiting
+    // a reply get an error value
     REDIS_CLIENT_DECL void disconnect();
 
     // Set custom error handler. 
     REDIS_CLIENT_DECL void installErrorHandler(
         const boost::function<void(const std::string &)> &handler);
 
-    // Execute command on Redis server.
-    REDIS_CLIENT_DECL void command(
-            const std::string &cmd,
-            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+    // Set a handler called once when the connection is closed after it
+    // was established, by disconnect() or after an error.
+    REDIS_CLIENT_DECL void installCloseHandler(const boost::function<void()> &handler);
 
-    // Execute command on Redis server with one argument.
-    REDIS_CLIENT_DECL void command(
-            const std::string &cmd, const RedisBuffer &arg1,
-            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+    // Set the maximum number of bytes of queued commands sent in one
+    // write. Zero sends one command per write.
+    REDIS_CLIENT_DECL void setPipelineLimit(size_t bytes);
 
-    // Execute command on Redis server with two arguments.
-    REDIS_CLIENT_DECL void command(
-            const std::string &cmd, const RedisBuffer &arg1, const RedisBuffer &arg2,
-            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+    // Execute command on Redis server with any number of arguments.
+    // Arguments are anything convertible to RedisBuffer; an optional
+    // reply handler may be passed last.
+    template<typename ...Args>
+    inline typename boost::disable_if<IsArgList<Args...> >::type command(
+            const std::string &cmd, const Args &...args);
 
-    // Execute command on Redis server with three arguments.
+    // Execute command on Redis server with the list of arguments.
     REDIS_CLIENT_DECL void command(
-            const std::string &cmd, const RedisBuffer &arg1,
-            const RedisBuffer &arg2, const RedisBuffer &arg3,
+            const std::string &cmd, const std::list<RedisBuffer> &args,
             const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
 
-    // Execute command on Redis server with four arguments.
+    // Execute command on Redis server with arguments that may own their
+    // memory, so the list can be built ahead and kept safely.
     REDIS_CLIENT_DECL void command(
-            const std::string &cmd, const RedisBuffer &arg1, const RedisBuffer &arg2,
-            const RedisBuffer &arg3, const RedisBuffer &arg4,
+            const std::string &cmd, const std::vector<RedisSlice> &args,
             const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
 
-    // Execute command on Redis server with five arguments.
-    REDIS_CLIENT_DECL void command(
-            const std::string &cmd, const RedisBuffer &arg1,
-            const RedisBuffer &arg2, const RedisBuffer &arg3,
-            const RedisBuffer &arg4, const RedisBuffer &arg5,
-            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+    // Like command(), but the handler gets an error value if no reply
+    // arrives within timeout. The reply, if it comes later, is dropped.
+    template<typename ...Args>
+    inline void timedCommand(const boost::posix_time::time_duration &timeout,
+                             const std::string &cmd, const Args &...args);
 
-    // Execute command on Redis server with six arguments.
-    REDIS_CLIENT_DECL void command(
-            const std::string &cmd, const RedisBuffer &arg1,
-            const RedisBuffer &arg2, const RedisBuffer &arg3,
-            const RedisBuffer &arg4, const RedisBuffer &arg5,
-            const RedisBuffer &arg6,
-            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+    // Execute command and return a future for the reply; an error value
+    // once timeout passes without one. A reply handler passed last runs
+    // before the future is made ready.
+    template<typename ...Args>
+    inline std::future<RedisValue> futureCommand(const boost::posix_time::time_duration &timeout,
+                                                 const std::string &cmd, const Args &...args);
 
+    // Deadline for every command not given one. Zero (the default) waits
+    // for the reply however long it takes.
+    REDIS_CLIENT_DECL void setCommandTimeout(const boost::posix_time::time_duration &timeout);
 
-    // Execute command on Redis server with seven arguments.
-    REDIS_CLIENT_DECL void command(
-            const std::string &cmd, const RedisBuffer &arg1,
-            const RedisBuffer &arg2, const RedisBuffer &arg3,
-            const RedisBuffer &arg4, const RedisBuffer &arg5,
-            const RedisBuffer &arg6, const RedisBuffer &arg7,
-            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
-
-    // Execute command on Redis server with the list of arguments.
-    REDIS_CLIENT_DECL void command(
-            const std::string &cmd, const std::list<RedisBuffer> &args,
-            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+    // Maximum number of commands awaiting a reply. Beyond it commands
+    // fail at once with an error value instead of queueing behind a
+    // stalled server. Zero (the default) is unbounded.
+    REDIS_CLIENT_DECL void setMaxPending(size_t commands);
 
     // Subscribe to channel. Handler msgHandler will be called
     // when someone publish message on channel. Call unsubscribe 
@@ -133,9 +146,34 @@ public:
             const boost::function<void(const std::vector<char> &msg, const std::string &channel)> &msgHandler,
             const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
 
+    // Subscribe to channel. msgHandler gets the payload as an owned
+    // slice of the received buffer, which it may keep, republish or
+    // write elsewhere without copying. Call unsubscribe to stop.
+    REDIS_CLIENT_DECL Handle subscribeSlice(
+            const std::string &channelName,
+            const boost::function<void(const RedisSlice &msg, const std::string &channel)> &msgHandler,
+            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+
     // Unsubscribe
     REDIS_CLIENT_DECL void unsubscribe(const Handle &handle);
 
+    // Subscribe to every channel matching a glob-style pattern, such as
+    // "device.*". msgHandler gets the name of the channel the message was
+    // published on. Call punsubscribe to stop the subscription.
+    REDIS_CLIENT_DECL Handle psubscribe(
+            const std::string &pattern,
+            const boost::function<void(const std::vector<char> &msg, const std::string &channel)> &msgHandler,
+            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+
+    // psubscribe with payloads passed as slices, see subscribeSlice.
+    REDIS_CLIENT_DECL Handle psubscribeSlice(
+            const std::string &pattern,
+            const boost::function<void(const RedisSlice &msg, const std::string &channel)> &msgHandler,
+            const boost::function<void(const RedisValue &)> &handler = &dummyHandler);
+
+    // Unsubscribe a handle returned by psubscribe
+    REDIS_CLIENT_DECL void punsubscribe(const Handle &handle);
+
     // Subscribe to channel. Handler msgHandler will be called
     // when someone publish message on channel; it will be 
     // unsubscribed after call.
@@ -154,10 +192,115 @@ public:
 protected:
     REDIS_CLIENT_DECL bool stateValid() const;
 
+    // addHandler registers the message handler under the handle id.
+    REDIS_CLIENT_DECL Handle doSubscribe(
+            const std::string &cmd, const std::string &name,
+            const boost::function<void(size_t id)> &addHandler,
+            const boost::function<void(const RedisValue &)> &handler);
+
+    REDIS_CLIENT_DECL void doUnsubscribe(const std::string &cmd, bool pattern, const Handle &handle);
+
+    typedef boost::function<void(const RedisValue &)> ReplyHandler;
+
+    REDIS_CLIENT_DECL static void fulfil(const boost::shared_ptr<std::promise<RedisValue> > &promise,
+                                         const ReplyHandler &handler, const RedisValue &value);
+
+    static inline size_t collectArgs(RedisBuffer *, ReplyHandler &)
+    {
+        return 0;
+    }
+
+    template<typename T, typename ...Rest>
+    static inline size_t collectArgs(RedisBuffer *items, ReplyHandler &handler,
+                                     const T &arg, const Rest &...rest)
+    {
+        size_t n = collectArg(items, handler, arg,
+                              typename boost::is_convertible<T, RedisBuffer>::type());
+        return n + collectArgs(items + n, handler, rest...);
+    }
+
+    static inline size_t collectArg(RedisBuffer *items, ReplyHandler &,
+                                    const RedisBuffer &arg, boost::true_type)
+    {
+        *items = arg;
+        return 1;
+    }
+
+    template<typename T>
+    static inline size_t collectArg(RedisBuffer *, ReplyHandler &handler,
+                                    const T &arg, boost::false_type)
+    {
+        handler = arg;
+        return 0;
+    }
+
 private:
     RedisClientImpl * pimpl;
 };
 
+template<typename ...Args>
+typename boost::disable_if<RedisAsyncClient::IsArgList<Args...> >::type RedisAsyncClient::command(
+        const std::string &cmd, const Args &...args)
+{
+    if(stateValid())
+    {
+        RedisBuffer items[1 + sizeof...(Args)];
+        ReplyHandler handler = &dummyHandler;
+
+        items[0] = cmd;
+
+        size_t count = 1 + collectArgs(items + 1, handler, args...);
+
+        pimpl->asyncCommand(items, count, handler);
+    }
+}
+
+template<typename ...Args>
+void RedisAsyncClient::timedCommand(const boost::posix_time::time_duration &timeout,
+                                    const std::string &cmd, const Args &...args)
+{
+    if(stateValid())
+    {
+        RedisBuffer items[1 + sizeof...(Args)];
+        ReplyHandler handler = &dummyHandler;
+
+        items[0] = cmd;
+
+        size_t count = 1 + collectArgs(items + 1, handler, args...);
+
+        pimpl->asyncCommand(items, count, handler,
+                            boost::posix_time::microsec_clock::universal_time() + timeout);
+    }
+}
+
+template<typename ...Args>
+std::future<RedisValue> RedisAsyncClient::futureCommand(
+        const boost::posix_time::time_duration &timeout,
+        const std::string &cmd, const Args &...args)
+{
+    boost::shared_ptr<std::promise<RedisValue> > promise(new std::promise<RedisValue>());
+    std::future<RedisValue> future = promise->get_future();
+
+    if(stateValid())
+    {
+        RedisBuffer items[1 + sizeof...(Args)];
+        ReplyHandler handler;
+
+        items[0] = cmd;
+
+        size_t count = 1 + collectArgs(items + 1, handler, args...);
+
+        pimpl->asyncCommand(items, count, boost::bind(&RedisAsyncClient::fulfil, promise, handler, _1),
+                            boost::posix_time::microsec_clock::universal_time() + timeout);
+    }
+    else
+    {
+        promise->set_value(RedisClientImpl::errorValue("ERR not connected"));
+    }
+
+    return future;
+}
+
 #ifdef REDIS_CLIENT_HEADER_ONLY
 #include "impl/redisasyncclient.cpp"
 #endif
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCACHE_H
+#define REDISCLIENT_REDISCACHE_H
+
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <stdint.h>
+#include <time.h>
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "redisbuffer.h"
+#include "redisvalue.h"
+#include "config.h"
+
+class RedisAsyncClient;
+
+// Local cache of GET, HGET and HGETALL replies for RedisSyncClient, see
+// RedisSyncClient::setCache(). Memory is bounded by an LRU byte budget and
+// entries expire after a TTL.
+//
+// Entries are kept only for the databases the cache tracks: track()
+// subscribes a RedisAsyncClient to the keyspace notifications of a
+// database, and every notification for a key drops its entries. The
+// server must publish them, e.g. "CONFIG SET notify-keyspace-events KA";
+// track() checks this first and leaves the database untracked if not.
+// Missed notifications would leave stale entries behind, so the cache
+// untracks itself when the tracking connection closes; call track()
+// again once it is reconnected.
+//
+// Must be owned by a boost::shared_ptr. Safe to use from several threads.
+class RedisReadCache : public boost::enable_shared_from_this<RedisReadCache>,
+                       boost::noncopyable {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;         // Dropped to stay within the budget
+        uint64_t expirations;       // Dropped when found past their TTL
+        uint64_t invalidations;     // Dropped because the key changed
+        size_t entries;
+        size_t bytes;
+
+        double hitRatio() const
+        {
+            return hits + misses == 0 ? 0.0 : double(hits) / double(hits + misses);
+        }
+    };
+
+    // ttl is in seconds, 0 to keep entries until they are evicted
+    // or invalidated.
+    REDIS_CLIENT_DECL explicit RedisReadCache(size_t maxBytes = 16 * 1024 * 1024,
+                                              time_t ttl = 60);
+
+    // Subscribe client to the keyspace notifications of database db.
+    // The client must be connected and is used for nothing else, as the
+    // cache installs its close handler; it may track several databases.
+    REDIS_CLIENT_DECL void track(RedisAsyncClient &client, int db = 0);
+
+    // Stop caching and drop every entry.
+    REDIS_CLIENT_DECL void untrack();
+
+    REDIS_CLIENT_DECL bool isTracking() const;
+
+    // True for the commands this cache keeps.
+    REDIS_CLIENT_DECL static bool cacheable(const std::vector<RedisBuffer> &items);
+
+    // True for SELECT; db is set to the database it names.
+    REDIS_CLIENT_DECL static bool selects(const std::vector<RedisBuffer> &items, int &db);
+
+    // Cached reply of a cacheable command run on database db.
+    REDIS_CLIENT_DECL bool lookup(int db, const std::vector<RedisBuffer> &items,
+                                  RedisValue &value);
+
+    // Invalidation count of the key a cacheable command reads, taken
+    // before the command is sent and passed to store(): a reply that
+    // raced with an invalidation of that key is not kept.
+    REDIS_CLIENT_DECL uint64_t epoch(int db, const std::vector<RedisBuffer> &items) const;
+
+    REDIS_CLIENT_DECL void store(int db, const std::vector<RedisBuffer> &items,
+                                 const RedisValue &value, uint64_t epoch);
+
+    // Drop the entries of key in database db.
+    REDIS_CLIENT_DECL void invalidate(int db, const RedisBuffer &key);
+
+    // Drop every entry.
+    REDIS_CLIENT_DECL void invalidateAll();
+
+    // Drop whatever a command that is not cacheable may change: the keys
+    // among its arguments, or everything for FLUSHDB and FLUSHALL.
+    REDIS_CLIENT_DECL void invalidateFor(int db, const std::vector<RedisBuffer> &items);
+
+    REDIS_CLIENT_DECL Stats stats() const;
+
+protected:
+    struct Entry {
+        std::string id;
+        std::string key;
+        RedisValue value;
+        size_t bytes;
+        time_t expires;
+    };
+
+    typedef std::list<Entry>::iterator EntryIterator;
+
+    // Entries and keys are named with their database in front.
+    REDIS_CLIENT_DECL static std::string makeId(int db, const std::vector<RedisBuffer> &items);
+    REDIS_CLIENT_DECL static std::string makeKey(int db, const char *key, size_t size);
+    REDIS_CLIENT_DECL static size_t keyEpochSlot(const std::string &key);
+    REDIS_CLIENT_DECL static size_t valueSize(const RedisValue &value);
+
+    // True if a CONFIG GET notify-keyspace-events reply publishes every
+    // change to the keys the cache keeps.
+    REDIS_CLIENT_DECL static bool notifiesKeyspace(const RedisValue &config);
+
+    REDIS_CLIENT_DECL static void subscribeKeyspace(const boost::weak_ptr<RedisReadCache> &cache,
+                                                    RedisAsyncClient &client, int db);
+
+    // Client handlers; they may outlive the cache, so hold it weakly.
+    // client is only used while a successful reply is handled.
+    REDIS_CLIENT_DECL static void onTrackConfig(const boost::weak_ptr<RedisReadCache> &cache,
+                                                RedisAsyncClient *client, int db,
+                                                const RedisValue &value);
+    REDIS_CLIENT_DECL static void onTrackClosed(const boost::weak_ptr<RedisReadCache> &cache);
+    REDIS_CLIENT_DECL static void onTrackAck(const boost::weak_ptr<RedisReadCache> &cache,
+                                             int db, const RedisValue &value);
+    REDIS_CLIENT_DECL static void onNotification(const boost::weak_ptr<RedisReadCache> &cache,
+                                                 int db, size_t prefixSize,
+                                                 const std::string &channel);
+
+    // Called with mutex held.
+    REDIS_CLIENT_DECL void erase(EntryIterator it);
+    REDIS_CLIENT_DECL void invalidateKey(const std::string &key);
+    REDIS_CLIENT_DECL void clear();
+
+private:
+    mutable boost::mutex mutex;
+
+    const size_t maxBytes;
+    const time_t ttl;
+
+    // Most recently used first
+    std::list<Entry> lru;
+    boost::unordered_map<std::string, EntryIterator> entries;
+    // Entries by the redis key they were read from
+    boost::unordered_map<std::string, std::vector<EntryIterator> > keys;
+
+    size_t bytes;
+
+    // Invalidation counts: one for invalidateAll() and untrack(), and one
+    // per key, shared by the keys that hash to the same slot.
+    enum { keyEpochSlots = 1024 };
+    uint64_t invalidationEpoch;
+    uint64_t keyEpochs[keyEpochSlots];
+
+    std::set<int> tracked;
+
+    Stats counters;
+};
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "impl/rediscache.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISCACHE_H
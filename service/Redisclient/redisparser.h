@@ -27,10 +27,22 @@ public:
 
     REDIS_CLIENT_DECL RedisValue result();
 
+    // Bytes of the bulk string being received that are still missing,
+    // or 0. The caller may read up to size of them (at most bulkPending())
+    // straight into bulkTail(size) and report how many arrived with
+    // commitBulk() instead of passing them to parse().
+    REDIS_CLIENT_DECL size_t bulkPending() const;
+    REDIS_CLIENT_DECL char *bulkTail(size_t size);
+    REDIS_CLIENT_DECL void commitBulk(size_t size);
+
 protected:
     REDIS_CLIENT_DECL std::pair<size_t, ParseResult> parseChunk(const char *ptr, size_t size);
     REDIS_CLIENT_DECL std::pair<size_t, ParseResult> parseArray(const char *ptr, size_t size);
 
+    // Push a value, taking over the contents of the argument.
+    REDIS_CLIENT_DECL void pushBytes(std::vector<char> &bytes);
+    REDIS_CLIENT_DECL void pushArray(std::vector<RedisValue> &array);
+
     static inline bool isChar(int c)
     {
         return c >= 0 && c <= 127;
@@ -65,7 +77,9 @@ private:
 
     } state;
 
+    // Bulk bytes still missing, and the room last handed out by bulkTail().
     long int bulkSize;
+    size_t bulkTailSize;
     std::vector<char> buf;
     std::stack<long int> arrayStack;
     std::stack<RedisValue> valueStack;
@@ -75,6 +89,10 @@ private:
     static const char integerReply = ':';
     static const char bulkReply = '$';
     static const char arrayReply = '*';
+
+    // The length of a bulk string comes from the server, so its buffer is
+    // grown as the bytes arrive and only this much is reserved up front.
+    enum { bulkReserveMax = 64 * 1024 };
 };
 
 #ifdef REDIS_CLIENT_HEADER_ONLY
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISSLICE_H
+#define REDISCLIENT_REDISSLICE_H
+
+#include <boost/asio/buffer.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <string.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "redisbuffer.h"
+#include "config.h"
+
+// Binary-safe byte range that either borrows memory or shares ownership
+// of a reference-counted buffer. Copying a slice never copies the bytes.
+//
+// Owned slices stay valid as long as any copy of them exists, so they may
+// be kept, queued or handed to another thread: a published payload
+// received through RedisAsyncClient::subscribeSlice() can be republished
+// or written to a socket without copying it. Borrowed slices are views
+// like RedisBuffer and must not outlive the memory they point to; call
+// own() before keeping one.
+class RedisSlice
+{
+public:
+    typedef boost::shared_ptr<const std::vector<char> > SharedBytes;
+
+    inline RedisSlice();
+
+    // Share all of bytes.
+    inline explicit RedisSlice(const SharedBytes &bytes);
+
+    // Share size bytes of bytes from offset. Throws std::out_of_range if
+    // they run past the end of bytes.
+    inline RedisSlice(const SharedBytes &bytes, size_t offset, size_t size);
+
+    // View of memory owned by the caller.
+    static inline RedisSlice borrow(const char *ptr, size_t size);
+    static inline RedisSlice borrow(const std::string &s);
+
+    // Owned copy.
+    static inline RedisSlice copy(const char *ptr, size_t size);
+    static inline RedisSlice copy(const std::string &s);
+
+    // Owned slice of the contents of buf, taken without copying; buf is
+    // left empty.
+    static inline RedisSlice adopt(std::vector<char> &buf);
+
+    inline const char *data() const;
+    inline size_t size() const;
+    inline bool empty() const;
+
+    // True if the slice keeps its memory alive.
+    inline bool owned() const;
+
+    // The slice itself if owned, otherwise an owned copy.
+    inline RedisSlice own() const;
+
+    // Part of this slice, sharing its ownership. Throws std::out_of_range
+    // if it runs past the end of the slice.
+    inline RedisSlice sub(size_t offset, size_t size) const;
+
+    // Buffer holding the bytes of an owned slice, or null.
+    inline const SharedBytes &bytes() const;
+
+    inline std::string toString() const;
+
+    inline boost::asio::const_buffer buffer() const;
+
+    // Use as a command argument.
+    inline operator RedisBuffer() const;
+
+    inline bool operator==(const RedisSlice &other) const;
+    inline bool operator!=(const RedisSlice &other) const;
+
+private:
+    static inline void checkRange(size_t offset, size_t size, size_t total);
+
+    SharedBytes bytes_;
+    const char *ptr_;
+    size_t size_;
+};
+
+
+RedisSlice::RedisSlice()
+    : ptr_(NULL), size_(0)
+{
+}
+
+RedisSlice::RedisSlice(const SharedBytes &bytes)
+    : bytes_(bytes),
+      ptr_(bytes && !bytes->empty() ? &(*bytes)[0] : NULL),
+      size_(bytes ? bytes->size() : 0)
+{
+}
+
+RedisSlice::RedisSlice(const SharedBytes &bytes, size_t offset, size_t size)
+    : bytes_(bytes), ptr_(NULL), size_(size)
+{
+    checkRange(offset, size, bytes ? bytes->size() : 0);
+
+    if( bytes && !bytes->empty() )
+        ptr_ = &(*bytes)[0] + offset;
+}
+
+RedisSlice RedisSlice::borrow(const char *ptr, size_t size)
+{
+    RedisSlice slice;
+
+    slice.ptr_ = ptr;
+    slice.size_ = size;
+    return slice;
+}
+
+RedisSlice RedisSlice::borrow(const std::string &s)
+{
+    return borrow(s.data(), s.size());
+}
+
+RedisSlice RedisSlice::copy(const char *ptr, size_t size)
+{
+    return RedisSlice(SharedBytes(new std::vector<char>(ptr, ptr + size)));
+}
+
+RedisSlice RedisSlice::copy(const std::string &s)
+{
+    return copy(s.data(), s.size());
+}
+
+RedisSlice RedisSlice::adopt(std::vector<char> &buf)
+{
+    boost::shared_ptr<std::vector<char> > bytes(new std::vector<char>());
+
+    bytes->swap(buf);
+    return RedisSlice(bytes);
+}
+
+const char *RedisSlice::data() const
+{
+    return ptr_;
+}
+
+size_t RedisSlice::size() const
+{
+    return size_;
+}
+
+bool RedisSlice::empty() const
+{
+    return size_ == 0;
+}
+
+bool RedisSlice::owned() const
+{
+    return bytes_ || size_ == 0;
+}
+
+RedisSlice RedisSlice::own() const
+{
+    return owned() ? *this : copy(ptr_, size_);
+}
+
+RedisSlice RedisSlice::sub(size_t offset, size_t size) const
+{
+    checkRange(offset, size, size_);
+
+    RedisSlice slice(*this);
+
+    slice.ptr_ = ptr_ + offset;
+    slice.size_ = size;
+    return slice;
+}
+
+const RedisSlice::SharedBytes &RedisSlice::bytes() const
+{
+    return bytes_;
+}
+
+std::string RedisSlice::toString() const
+{
+    return std::string(ptr_, ptr_ + size_);
+}
+
+boost::asio::const_buffer RedisSlice::buffer() const
+{
+    return boost::asio::const_buffer(ptr_, size_);
+}
+
+RedisSlice::operator RedisBuffer() const
+{
+    return RedisBuffer(ptr_, size_);
+}
+
+bool RedisSlice::operator==(const RedisSlice &other) const
+{
+    return size_ == other.size_ && (size_ == 0 || memcmp(ptr_, other.ptr_, size_) == 0);
+}
+
+bool RedisSlice::operator!=(const RedisSlice &other) const
+{
+    return !(*this == other);
+}
+
+void RedisSlice::checkRange(size_t offset, size_t size, size_t total)
+{
+    // Written so that offset + size cannot overflow
+    if( offset > total || size > total - offset )
+        throw std::out_of_range("RedisSlice: range out of bounds");
+}
+
+#endif // REDISCLIENT_REDISSLICE_H
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISSTREAMPARSER_H
+#define REDISCLIENT_REDISSTREAMPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+
+// Receives parse events from RedisStreamParser. Pointers passed to the
+// callbacks are valid only for the duration of the call: they point into
+// the input buffer when the data was contiguous in it, or into the
+// parser's spill buffer when it spanned reads.
+class RedisReplyVisitor
+{
+public:
+    virtual ~RedisReplyVisitor() {}
+
+    virtual void onString(const char *ptr, size_t size) = 0;
+    virtual void onError(const char *ptr, size_t size) = 0;
+    virtual void onInteger(int64_t value) = 0;
+    virtual void onBulk(const char *ptr, size_t size) = 0;
+    virtual void onNull() = 0;
+
+    // Followed by size elements, then onArrayEnd().
+    virtual void onArrayBegin(size_t size) = 0;
+    virtual void onArrayEnd() = 0;
+};
+
+// SAX-style RESP parser. Unlike RedisParser it builds no RedisValue tree:
+// values are reported to a visitor as they complete, and all internal
+// buffers are reused across replies so the steady state does not allocate.
+class RedisStreamParser
+{
+public:
+    REDIS_CLIENT_DECL RedisStreamParser();
+
+    enum ParseResult {
+        Completed,
+        Incompleted,
+        Error,
+    };
+
+    // Feed input. Returns the number of bytes consumed and Completed when
+    // one whole top-level reply has been reported to visitor; call again
+    // with the rest of the input for the next reply.
+    REDIS_CLIENT_DECL std::pair<size_t, ParseResult> parse(
+            const char *ptr, size_t size, RedisReplyVisitor &visitor);
+
+    // Drop any partially parsed reply.
+    REDIS_CLIENT_DECL void reset();
+
+protected:
+    REDIS_CLIENT_DECL bool processLine(const char *ptr, size_t size,
+                                       RedisReplyVisitor &visitor, bool &completed);
+    REDIS_CLIENT_DECL bool valueCompleted(RedisReplyVisitor &visitor);
+
+    REDIS_CLIENT_DECL static bool parseInt(const char *ptr, size_t size, int64_t &value);
+
+private:
+    enum State {
+        Start = 0,
+        Line = 1,
+        LineLF = 2,
+        Bulk = 3,
+        BulkCR = 4,
+        BulkLF = 5,
+    } state;
+
+    char lineType;
+    size_t bulkSize;
+
+    // Holds a line or bulk string that spans reads.
+    std::vector<char> spill;
+    // Remaining element count of each open array.
+    std::vector<int64_t> arrayStack;
+
+    static const char stringReply = '+';
+    static const char errorReply = '-';
+    static const char integerReply = ':';
+    static const char bulkReply = '$';
+    static const char arrayReply = '*';
+};
+
+// Visitor that keeps one reply in flat, reusable storage. Items are kept
+// in pre-order (an Array item is followed by its elements) and string data
+// is copied into a single byte arena. clear() keeps the capacity, so
+// replies such as LRANGE or MGET are collected without heap allocations
+// once the arena has grown to fit them.
+class RedisReplyArena : public RedisReplyVisitor
+{
+public:
+    enum Type {
+        Null,
+        Integer,
+        String,
+        Error,
+        Bulk,
+        Array,
+    };
+
+    struct Item {
+        Type type;
+        size_t offset;      // Start of the data in the arena
+        size_t size;        // Bytes, or number of elements for Array
+        int64_t integer;
+    };
+
+    REDIS_CLIENT_DECL void clear();
+
+    size_t count() const { return items.size(); }
+    const Item &item(size_t i) const { return items[i]; }
+
+    // Data of a String, Error or Bulk item.
+    const char *data(const Item &item) const
+    {
+        return bytes.empty() ? 0 : &bytes[0] + item.offset;
+    }
+
+    REDIS_CLIENT_DECL virtual void onString(const char *ptr, size_t size);
+    REDIS_CLIENT_DECL virtual void onError(const char *ptr, size_t size);
+    REDIS_CLIENT_DECL virtual void onInteger(int64_t value);
+    REDIS_CLIENT_DECL virtual void onBulk(const char *ptr, size_t size);
+    REDIS_CLIENT_DECL virtual void onNull();
+    REDIS_CLIENT_DECL virtual void onArrayBegin(size_t size);
+    REDIS_CLIENT_DECL virtual void onArrayEnd();
+
+protected:
+    REDIS_CLIENT_DECL void push(Type type, const char *ptr, size_t size, int64_t integer);
+
+private:
+    std::vector<Item> items;
+    std::vector<char> bytes;
+};
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "impl/redisstreamparser.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISSTREAMPARSER_H
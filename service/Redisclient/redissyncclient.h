@@ -14,6 +14,7 @@
 #include <list>
 
 #include "impl/redisclientimpl.h"
+#include "rediscache.h"
 #include "redisbuffer.h"
 #include "redisvalue.h"
 #include "config.h"
@@ -84,11 +85,22 @@ public:
     REDIS_CLIENT_DECL RedisValue command(
             const std::string &cmd, const std::list<std::string> &args);
 
+    // Serve GET, HGET and HGETALL from cache while it tracks the
+    // database selected on this client; null to disable. Other commands
+    // invalidate the keys they name. A cache may be shared by several
+    // clients.
+    REDIS_CLIENT_DECL void setCache(const boost::shared_ptr<RedisReadCache> &cache);
+
 protected:
     REDIS_CLIENT_DECL bool stateValid() const;
 
+    REDIS_CLIENT_DECL RedisValue execute(const std::vector<RedisBuffer> &items);
+
 private:
     boost::shared_ptr<RedisClientImpl> pimpl;
+    boost::shared_ptr<RedisReadCache> cache;
+    // Database chosen with SELECT, for the cache.
+    int db;
 };
 
 #ifdef REDIS_CLIENT_HEADER_ONLY
@@ -40,6 +40,19 @@ public:
     // otherwise returns an empty array.
     REDIS_CLIENT_DECL std::vector<RedisValue> toArray() const;
 
+    // Return a reference to the byte string without copying it.
+    // Throws boost::bad_get if type is not a byte string.
+    REDIS_CLIENT_DECL const std::vector<char> &getByteArray() const;
+    REDIS_CLIENT_DECL std::vector<char> &getByteArray();
+
+    // Return a reference to the array without copying it.
+    // Throws boost::bad_get if type is not an array.
+    REDIS_CLIENT_DECL const std::vector<RedisValue> &getArray() const;
+    REDIS_CLIENT_DECL std::vector<RedisValue> &getArray();
+
+    // Exchange contents with other without copying the payload.
+    REDIS_CLIENT_DECL void swap(RedisValue &other);
+
     // Return the string representation of the value. Use
     // for dump content of the value.
     REDIS_CLIENT_DECL std::string inspect() const;
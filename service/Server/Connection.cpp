@@ -1,9 +1,11 @@
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <boost/bind.hpp>
 #include <boost/logic/tribool.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <chrono>
 
 #include "RequestHandler.hpp"
 #include "Connection.hpp"
@@ -12,26 +14,40 @@ namespace service {
 
 connection::connection(boost::asio::io_service& io_service,
     request_handler& handler, 
-    std::list<connection_attr> &connect_attr_list) : 
+    connection_registry &registry,
+    timing_wheel &wheel,
+    const connection_options &options) : 
     // Member initialization
     m_strand(io_service),
     m_socket(io_service),
     m_request_handler(handler),
     m_request(),
-    m_reply(),
-    m_reading(READ_HEAD),
+    m_options(options),
+    m_outbox(),
+    m_outbox_bytes(0),
+    m_write_buffers(),
+    m_write_frames(0),
+    m_reading(false),
+    m_read_paused(false),
+    m_inbuf(HM_RECV_BUFFER_SIZE),
+    m_framer(options.max_body_size),
     m_attr(),
-    m_connect_attr_list(connect_attr_list)
+    m_registry(registry),
+    m_wheel(wheel),
+    m_last_rx(0),
+    m_last_tx(0)
 {
-    m_attr.last_t = boost::posix_time::second_clock::local_time();
-    m_attr.id = boost::posix_time::to_iso_string(m_attr.last_t);
+    m_attr.id = m_registry.next_id();
+    // An empty gather list would complete at once and be re-armed forever.
+    if (m_options.max_write_frames == 0)
+        m_options.max_write_frames = 1;
 }
 
 connection::~connection()
 {
+    m_registry.erase(m_attr.id);
     std::cout << "Remove client[" << m_attr.id << "] total[" << 
-        m_connect_attr_list.size() << "]" << std::endl;
-    m_connect_attr_list.remove(m_attr);
+        m_registry.size() << "]" << std::endl;
 }
 
 boost::asio::ip::tcp::socket& connection::socket()
@@ -41,15 +57,36 @@ boost::asio::ip::tcp::socket& connection::socket()
 
 void connection::start()
 {
+    boost::system::error_code ec;
+    boost::asio::ip::tcp::endpoint remote = m_socket.remote_endpoint(ec);
+    if (!ec)
+    {
+        m_attr.ip = remote.address().to_string();
+        m_attr.port = remote.port();
+    }
     m_attr.last_t = boost::posix_time::second_clock::local_time();
-    m_connect_attr_list.push_back(m_attr);
+    m_registry.insert(m_attr);
     
     std::cout << "New client[" << m_attr.id << "] total[" << 
-        m_connect_attr_list.size() << "]" << std::endl;
-        
-    m_reading = READ_HEAD;
-    m_socket.async_read_some(
-        boost::asio::buffer(&m_request.head, sizeof(m_request.head)),
+        m_registry.size() << "]" << std::endl;
+
+    m_last_rx = m_last_tx = now_ms();
+    if (m_options.idle_timeout || m_options.heartbeat_interval)
+    {
+        std::size_t first = std::min(
+            m_options.idle_timeout ? m_options.idle_timeout : m_options.heartbeat_interval,
+            m_options.heartbeat_interval ? m_options.heartbeat_interval : m_options.idle_timeout);
+        m_wheel.schedule(shared_from_this(), 
+            first * 1000 / m_wheel.tick().total_milliseconds());
+    }
+
+    do_read();
+}
+
+void connection::do_read()
+{
+    m_reading = true;
+    m_socket.async_read_some(m_inbuf.prepare(),
         m_strand.wrap(boost::bind(&connection::handle_read, shared_from_this(),
             boost::asio::placeholders::error,
             boost::asio::placeholders::bytes_transferred)));
@@ -58,35 +95,51 @@ void connection::start()
 void connection::handle_read(const boost::system::error_code& e,
     std::size_t bytes_transferred)
 {
+    m_reading = false;
+
     if (!e)
     {
-        switch(m_reading)
+        m_inbuf.commit(bytes_transferred);
+        m_last_rx.store(now_ms(), std::memory_order_relaxed);
+
+        // Dispatch every complete frame buffered so far.
+        for (;;)
         {
-            case READ_HEAD:
-                m_reading = READ_BODY;
-                std::cout << "MessageID:" << std::hex << m_request.head.cmd << std::dec << std::endl;
-                m_request.body = new char[m_request.head.size];
-                m_socket.async_read_some(
-                    boost::asio::buffer(m_request.body, m_request.head.size),
-                    m_strand.wrap(boost::bind(&connection::handle_read, shared_from_this(),
-                        boost::asio::placeholders::error,
-                        boost::asio::placeholders::bytes_transferred)));
-                break;
-            case READ_BODY:
-                m_reading = READ_HEAD;
-                std::cout << "Read size=" << bytes_transferred << std::endl;
-
-                /// TODO: Handle request
-                m_request_handler.handle_request(m_request, m_reply);
-                delete [] m_request.body;
-                m_socket.async_read_some(
-                    boost::asio::buffer(&m_request.head, sizeof(m_request.head)),
-                    m_strand.wrap(boost::bind(&connection::handle_read, shared_from_this(),
-                        boost::asio::placeholders::error,
-                        boost::asio::placeholders::bytes_transferred)));
+            boost::tribool result = m_framer.parse(m_inbuf, m_request);
+            if (result)
+            {
+                // Heartbeats only refresh m_last_rx.
+                if (m_request.head.cmd == HM_CMD_HEARTBEAT)
+                {
+                    m_request.body.reset();
+                    continue;
+                }
+                m_request_handler.handle_request(m_request, 
+                    boost::bind(&connection::send_reply, shared_from_this(), 
+                        m_request.head.session, _1));
+                // Give the body back to the pool unless the handler kept it.
+                m_request.body.reset();
+            }
+            else if (!result)
+            {
+                std::cerr << "Bad frame from client[" << m_attr.id << "] cmd[" 
+                    << std::hex << m_request.head.cmd << std::dec << "] size[" 
+                    << m_request.head.size << "]" << std::endl;
+                boost::system::error_code ignored_ec;
+                m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
+                return;
+            }
+            else
+            {
                 break;
+            }
         }
-        
+
+        // Hold off the client while its replies pile up; handle_write resumes.
+        if (m_outbox_bytes.load(std::memory_order_relaxed) >= m_options.high_watermark)
+            m_read_paused = true;
+        else
+            do_read();
     }
 
     // If an error occurs then no new asynchronous operations are started. This
@@ -95,20 +148,150 @@ void connection::handle_read(const boost::system::error_code& e,
     // handler returns. The connection class's destructor closes the socket.
 }
 
+void connection::send(const hm_message &msg)
+{
+    m_strand.dispatch(boost::bind(&connection::queue_message, shared_from_this(), msg));
+}
+
+void connection::send_reply(unsigned int session, hm_message &rep)
+{
+    rep.head.session = session;
+    rep.head.size = rep.body.size();
+    send(rep);
+}
+
+void connection::queue_message(const hm_message &msg)
+{
+    m_outbox.push_back(msg);
+    m_outbox_bytes.fetch_add(sizeof(msg.head) + msg.body.size(),
+        std::memory_order_relaxed);
+    m_last_tx.store(now_ms(), std::memory_order_relaxed);
+    if (m_write_frames == 0)
+        start_write();
+}
+
+void connection::start_write()
+{
+    m_write_buffers.clear();
+    std::size_t bytes = 0;
+    std::size_t frames = 0;
+
+    // Coalesce queued frames into one gathered write, within the caps.
+    for (std::deque<hm_message>::const_iterator it = m_outbox.begin();
+        it != m_outbox.end() && frames < m_options.max_write_frames; ++it)
+    {
+        std::size_t size = sizeof(it->head) + it->body.size();
+        if (frames > 0 && bytes + size > m_options.max_write_bytes)
+            break;
+
+        m_write_buffers.push_back(boost::asio::buffer(&it->head, sizeof(it->head)));
+        if (!it->body.empty())
+            m_write_buffers.push_back(boost::asio::buffer(it->body.data(), it->body.size()));
+        bytes += size;
+        ++frames;
+    }
+
+    m_write_frames = frames;
+    boost::asio::async_write(m_socket, m_write_buffers,
+        m_strand.wrap(boost::bind(&connection::handle_write, shared_from_this(),
+            boost::asio::placeholders::error)));
+}
+
 void connection::handle_write(const boost::system::error_code& e)
 {
+    std::size_t frames = m_write_frames;
+    m_write_frames = 0;
+
     if (!e)
     {
-        // Initiate graceful connection closure.
-        boost::system::error_code ignored_ec;
-        m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
+        for (std::size_t i = 0; i < frames; ++i)
+        {
+            m_outbox_bytes.fetch_sub(sizeof(m_outbox.front().head) +
+                m_outbox.front().body.size(), std::memory_order_relaxed);
+            m_outbox.pop_front();
+        }
+
+        if (!m_outbox.empty())
+            start_write();
+
+        if (m_read_paused &&
+            m_outbox_bytes.load(std::memory_order_relaxed) <= m_options.low_watermark)
+        {
+            m_read_paused = false;
+            if (!m_reading)
+                do_read();
+        }
+        return;
     }
 
-    // No new asynchronous operations are started. This means that all shared_ptr
-    // references to the connection object will disappear and the object will be
-    // destroyed automatically after this handler returns. The connection class's
-    // destructor closes the socket.
+    // Nothing more can be delivered; drop what is queued. Once the pending
+    // read fails too, all shared_ptr references to the connection go away
+    // and the destructor closes the socket.
+    m_outbox.clear();
+    m_outbox_bytes.store(0, std::memory_order_relaxed);
 }
 
-} // service
+void connection::close()
+{
+    m_strand.post(boost::bind(&connection::do_close, shared_from_this()));
+}
+
+void connection::do_close()
+{
+    // The pending read fails and the connection is released as usual.
+    boost::system::error_code ignored_ec;
+    m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
+    m_socket.close(ignored_ec);
+}
 
+std::size_t connection::on_wheel_tick()
+{
+    long long now = now_ms();
+    long long next = -1;
+
+    if (m_options.idle_timeout)
+    {
+        long long deadline = m_last_rx.load(std::memory_order_relaxed) + 
+            static_cast<long long>(m_options.idle_timeout) * 1000;
+        if (now >= deadline)
+        {
+            std::cout << "Idle client[" << m_attr.id << "] closed" << std::endl;
+            close();
+            return 0;
+        }
+        next = deadline;
+    }
+
+    if (m_options.heartbeat_interval)
+    {
+        long long interval = static_cast<long long>(m_options.heartbeat_interval) * 1000;
+        long long due = m_last_tx.load(std::memory_order_relaxed) + interval;
+        if (now >= due)
+        {
+            hm_message beat;
+            beat.head.cmd = HM_CMD_HEARTBEAT;
+            beat.head.size = 0;
+            beat.head.error = HM_OK;
+            beat.head.session = 0;
+            send(beat);
+            due = now + interval;
+        }
+        if (next < 0 || due < next)
+            next = due;
+    }
+
+    if (next < 0)
+        return 0;
+
+    // Round up so the visit never comes early.
+    long long tick = m_wheel.tick().total_milliseconds();
+    return static_cast<std::size_t>((next - now + tick - 1) / tick);
+}
+
+long long connection::now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // service
@@ -6,74 +6,66 @@
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/logic/tribool.hpp>
 #include <string>
-#include <list>
 #include <sstream>
+#include <atomic>
+#include <deque>
+#include <vector>
 
 #include "RequestHandler.hpp"
 #include "Protocol.hpp"
+#include "MessageFramer.hpp"
+#include "RingBuffer.hpp"
+#include "ConnectionRegistry.hpp"
+#include "TimingWheel.hpp"
 
 namespace service {
 
-enum ReadStatus
+/// Per-connection limits, all with usable defaults.
+struct connection_options
 {
-    READ_HEAD,
-    READ_BODY
-};
-
-struct connection_attr
-{
-    std::string id;    /* Init once, read only */
-    std::string ip;
-    unsigned short port;
-    boost::posix_time::ptime last_t;
-    connection_attr()
+    /// Largest hm_head::size accepted from a client.
+    std::size_t max_body_size;
+    /// Most bytes gathered into one async_write (one frame always fits).
+    std::size_t max_write_bytes;
+    /// Most frames gathered into one async_write; 0 is taken as 1.
+    std::size_t max_write_frames;
+    /// Stop reading from the client once this many bytes are queued to it...
+    std::size_t high_watermark;
+    /// ...and resume when the queue drains below this.
+    std::size_t low_watermark;
+    /// Close a client that sent nothing for this many seconds (0: never).
+    std::size_t idle_timeout;
+    /// Send HM_CMD_HEARTBEAT after this many seconds without output (0: never).
+    std::size_t heartbeat_interval;
+
+    connection_options()
+        : max_body_size(HM_MAX_BODY_SIZE),
+          max_write_bytes(64 * 1024),
+          max_write_frames(64),
+          high_watermark(1024 * 1024),
+          low_watermark(256 * 1024),
+          idle_timeout(0),
+          heartbeat_interval(0)
     {
-        
-    }
-
-    connection_attr &operator=(connection_attr &o)
-    {
-        this->ip = o.ip;
-        this->last_t = o.last_t;
-        this->port = o.port;
-        return *this;
-    }
-    connection_attr &operator=(const connection_attr &o)
-    {
-        this->ip = o.ip;
-        this->last_t = o.last_t;
-        this->port = o.port;
-        return *this;
-    }
-    bool operator==(connection_attr &o)
-    {
-        if(this->id == o.id)
-            return true;
-        else
-            return false;
-    }
-    bool operator==(const connection_attr &o)
-    {
-        if(this->id == o.id)
-            return true;
-        else
-            return false;
     }
 };
 
 /// Represents a single connection from a client.
 class connection
     :   public boost::enable_shared_from_this<connection>,
+        public wheel_client,
         private boost::noncopyable
 {
 public:
-    /// Construct a connection with the given io_service.
+    /// Construct a connection with the given io_service; wheel must run
+    /// on the same io_service.
     explicit connection(boost::asio::io_service& io_service,
         request_handler& handler, 
-        std::list<connection_attr> &connect_attr_list);
+        connection_registry &registry,
+        timing_wheel &wheel,
+        const connection_options &options = connection_options());
 
     ~connection();
 
@@ -83,14 +75,48 @@ public:
     /// Start the first asynchronous operation for the connection.
     void start();
 
+    /// Queue msg for delivery to the client as is. Safe to call from any thread.
+    void send(const hm_message &msg);
+
+    /// Queue rep as the reply to the request with the given session.
+    /// Safe to call from any thread.
+    void send_reply(unsigned int session, hm_message &rep);
+
+    /// Bytes queued for the client and not yet written.
+    std::size_t pending_bytes() const
+    {
+        return m_outbox_bytes.load(std::memory_order_relaxed);
+    }
+
+    /// Close the socket; safe to call from any thread.
+    void close();
+
+    /// Idle and heartbeat check, called by the timing wheel.
+    virtual std::size_t on_wheel_tick();
+
 private:
+    /// Read whatever the socket has into the free space of the ring.
+    void do_read();
+
     /// Handle completion of a read operation.
     void handle_read(const boost::system::error_code& e,
         std::size_t bytes_transferred);
 
+    /// Append a message to the outbound queue (runs in the strand).
+    void queue_message(const hm_message &msg);
+
+    /// Write as many queued messages as the limits allow in one go.
+    void start_write();
+
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e);
 
+    /// Shut down and close the socket (runs in the strand).
+    void do_close();
+
+    /// Milliseconds on a monotonic clock.
+    static long long now_ms();
+
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand m_strand;
 
@@ -103,19 +129,49 @@ private:
     /// The incoming request.
     hm_message m_request;
 
-    /// The reply to be sent back to the client.
-    hm_message m_reply;
+    connection_options m_options;
+
+    /// Messages waiting to be written, oldest first.
+    std::deque<hm_message> m_outbox;
 
-    /// Read process status
-    ReadStatus m_reading;
+    /// Header+body bytes held in m_outbox. Written in the strand, read by
+    /// pending_bytes() from any thread.
+    std::atomic<std::size_t> m_outbox_bytes;
+
+    /// Gather list for the write in flight, reused between writes.
+    std::vector<boost::asio::const_buffer> m_write_buffers;
+
+    /// Frames from the front of m_outbox covered by the write in flight;
+    /// zero when no write is in flight.
+    std::size_t m_write_frames;
+
+    /// Whether an async_read_some is in flight.
+    bool m_reading;
+
+    /// Reading is suspended because the client is not draining its queue.
+    bool m_read_paused;
+
+    /// Buffered, not yet framed input.
+    ring_buffer m_inbuf;
+
+    /// Splits m_inbuf into hm_head+body frames.
+    message_framer m_framer;
 
     connection_attr m_attr;
 
-    std::list<connection_attr> &m_connect_attr_list;
+    /// Where this connection is listed while started.
+    connection_registry &m_registry;
+
+    /// Drives idle timeout and heartbeats.
+    timing_wheel &m_wheel;
+
+    /// Last time input arrived / output was queued, from now_ms(). Written
+    /// in the strand, read by the wheel.
+    std::atomic<long long> m_last_rx;
+    std::atomic<long long> m_last_tx;
 };
 
 typedef boost::shared_ptr<connection> connection_ptr;
-typedef std::list<connection_attr> connect_attr_list;
 
 } // service
 
@@ -0,0 +1,57 @@
+
+#include "ConnectionRegistry.hpp"
+
+namespace service {
+
+connection_registry::connection_registry()
+    : m_next_id(1), m_size(0)
+{
+}
+
+boost::uint64_t connection_registry::next_id()
+{
+    return m_next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+void connection_registry::insert(const connection_attr &attr)
+{
+    shard &s = shard_of(attr.id);
+    boost::mutex::scoped_lock lock(s.mutex);
+    std::pair<shard_map::iterator, bool> r = 
+        s.map.insert(std::make_pair(attr.id, attr));
+    if (r.second)
+        m_size.fetch_add(1, std::memory_order_relaxed);
+    else
+        r.first->second = attr;
+}
+
+void connection_registry::erase(boost::uint64_t id)
+{
+    shard &s = shard_of(id);
+    boost::mutex::scoped_lock lock(s.mutex);
+    if (s.map.erase(id))
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+}
+
+std::size_t connection_registry::size() const
+{
+    return m_size.load(std::memory_order_relaxed);
+}
+
+std::vector<connection_attr> connection_registry::snapshot() const
+{
+    std::vector<connection_attr> result;
+    result.reserve(size());
+    for (std::size_t i = 0; i < SHARD_COUNT; ++i)
+    {
+        boost::mutex::scoped_lock lock(m_shards[i].mutex);
+        for (shard_map::const_iterator it = m_shards[i].map.begin();
+            it != m_shards[i].map.end(); ++it)
+        {
+            result.push_back(it->second);
+        }
+    }
+    return result;
+}
+
+} // service
@@ -0,0 +1,70 @@
+#ifndef CONNECTION_REGISTRY_HPP
+#define CONNECTION_REGISTRY_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace service {
+
+struct connection_attr
+{
+    boost::uint64_t id;    /* Init once, read only */
+    std::string ip;
+    unsigned short port;
+    boost::posix_time::ptime last_t;
+    connection_attr() : id(0), port(0)
+    {
+    }
+};
+
+/// Registry of live connections, sharded by id so that connections
+/// starting and stopping on different io threads rarely share a lock.
+class connection_registry : private boost::noncopyable
+{
+public:
+    enum { SHARD_COUNT = 16 };
+
+    connection_registry();
+
+    /// Allocate a new, never reused connection id.
+    boost::uint64_t next_id();
+
+    /// Add or replace the entry for attr.id.
+    void insert(const connection_attr &attr);
+
+    /// Remove the entry for id, if any.
+    void erase(boost::uint64_t id);
+
+    /// Number of registered connections.
+    std::size_t size() const;
+
+    /// Copy of every entry, taken one shard at a time.
+    std::vector<connection_attr> snapshot() const;
+
+private:
+    typedef boost::unordered_map<boost::uint64_t, connection_attr> shard_map;
+
+    struct shard
+    {
+        mutable boost::mutex mutex;
+        shard_map map;
+    };
+
+    shard &shard_of(boost::uint64_t id) { return m_shards[id % SHARD_COUNT]; }
+
+    shard m_shards[SHARD_COUNT];
+
+    std::atomic<boost::uint64_t> m_next_id;
+
+    std::atomic<std::size_t> m_size;
+};
+
+} // service
+
+#endif // CONNECTION_REGISTRY_HPP
@@ -0,0 +1,93 @@
+
+#include <stdexcept>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "IoServicePool.hpp"
+
+namespace service {
+
+io_service_pool::io_service_pool(std::size_t pool_size, 
+    std::size_t threads_per_service, bool pin_threads) :
+    m_threads_per_service(threads_per_service),
+    m_pin_threads(pin_threads),
+    m_next_io_service(0)
+{
+    if (pool_size == 0 || threads_per_service == 0)
+        throw std::runtime_error("io_service_pool size is 0");
+
+    // Give all the io_services work to do so that their run() functions will
+    // not exit until they are explicitly stopped.
+    for (std::size_t i = 0; i < pool_size; ++i)
+    {
+        // A hint of 1 lets asio drop locking for single-threaded services.
+        io_service_ptr io_service(new boost::asio::io_service(threads_per_service));
+        work_ptr work(new boost::asio::io_service::work(*io_service));
+        m_io_services.push_back(io_service);
+        m_work.push_back(work);
+    }
+}
+
+void io_service_pool::run()
+{
+    // Create a pool of threads to run all of the io_services.
+    std::vector<boost::shared_ptr<boost::thread> > threads;
+    std::size_t cpu = 0;
+    for (std::size_t i = 0; i < m_io_services.size(); ++i)
+    {
+        for (std::size_t t = 0; t < m_threads_per_service; ++t)
+        {
+            boost::shared_ptr<boost::thread> thread(new boost::thread(
+                boost::bind(&io_service_pool::run_service, m_io_services[i], 
+                    m_pin_threads, cpu++)));
+            threads.push_back(thread);
+        }
+    }
+
+    // Wait for all threads in the pool to exit.
+    for (std::size_t i = 0; i < threads.size(); ++i)
+        threads[i]->join();
+}
+
+void io_service_pool::stop()
+{
+    // Explicitly stop all io_services.
+    for (std::size_t i = 0; i < m_io_services.size(); ++i)
+        m_io_services[i]->stop();
+}
+
+std::size_t io_service_pool::next_index()
+{
+    std::size_t next = m_next_io_service.fetch_add(1, std::memory_order_relaxed);
+    return next % m_io_services.size();
+}
+
+void io_service_pool::run_service(io_service_ptr io_service, bool pin, std::size_t cpu)
+{
+    if (pin)
+        pin_current_thread(cpu);
+    io_service->run();
+}
+
+void io_service_pool::pin_current_thread(std::size_t cpu)
+{
+#ifdef __linux__
+    unsigned int cores = boost::thread::hardware_concurrency();
+    if (cores == 0)
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+} // service
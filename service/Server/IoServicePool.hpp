@@ -0,0 +1,61 @@
+#ifndef IO_SERVICE_POOL_HPP
+#define IO_SERVICE_POOL_HPP
+
+#include <atomic>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace service {
+
+/// A set of io_service objects, each run by a fixed number of threads.
+/// One service run by N threads is the classic shared pool; N services
+/// run by one thread each gives every core its own reactor.
+class io_service_pool : private boost::noncopyable
+{
+public:
+    /// Construct the pool.
+    explicit io_service_pool(std::size_t pool_size, 
+        std::size_t threads_per_service, bool pin_threads);
+
+    /// Run all io_service objects in the pool, blocking until they stop.
+    void run();
+
+    /// Stop all io_service objects in the pool.
+    void stop();
+
+    /// Get the io_service at index i; index 0 hosts the acceptor.
+    boost::asio::io_service& get_io_service(std::size_t i) { return *m_io_services[i]; }
+
+    /// Index of the io_service to use for a new connection, round-robin.
+    std::size_t next_index();
+
+    std::size_t size() const { return m_io_services.size(); }
+
+private:
+    typedef boost::shared_ptr<boost::asio::io_service> io_service_ptr;
+    typedef boost::shared_ptr<boost::asio::io_service::work> work_ptr;
+
+    /// Bind the calling thread to one CPU.
+    static void pin_current_thread(std::size_t cpu);
+
+    /// Thread body: optionally pin, then run the service.
+    static void run_service(io_service_ptr io_service, bool pin, std::size_t cpu);
+
+    std::vector<io_service_ptr> m_io_services;
+
+    /// The work that keeps the io_services running.
+    std::vector<work_ptr> m_work;
+
+    std::size_t m_threads_per_service;
+
+    bool m_pin_threads;
+
+    /// The next io_service to use for a connection.
+    std::atomic<std::size_t> m_next_io_service;
+};
+
+} // service
+
+#endif // IO_SERVICE_POOL_HPP
@@ -5,89 +5,182 @@
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
+#include <iostream>
+#include <stdexcept>
 #include <vector>
 
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
 #include "Server.hpp"
 
 namespace service {
 
+/// Pause before accepting again after an accept error.
+static const long ACCEPT_RETRY_MS = 100;
+
+#ifdef SO_REUSEPORT
+typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+#endif
+
 server::server(const std::string& address, 
     const std::string& port, 
-    std::size_t thread_pool_size): 
+    std::size_t thread_pool_size,
+    const server_options &options): 
     
     // member initialization
-    m_thread_pool_size(thread_pool_size),
-    m_acceptor(m_io_service),
+    m_options(options),
     m_connection_list(),
-    m_new_connection(new connection(m_io_service, m_request_handler, m_connection_list)),
+    m_io_service_pool(
+        options.mode == IO_SERVICE_PER_CORE ? thread_pool_size : 1,
+        options.mode == IO_SERVICE_PER_CORE ? 1 : thread_pool_size,
+        options.mode == IO_SERVICE_PER_CORE && options.pin_threads),
+    m_wheels(),
+    m_listeners(),
+    m_accepted(0),
+    m_last_accepted(0),
+    m_last_sample(boost::posix_time::microsec_clock::universal_time()),
     m_request_handler()
 {
-    // Open the acceptor with the option to reuse the address (i.e. SO_REUSEADDR).
-    boost::asio::ip::tcp::resolver resolver(m_io_service);
+    for (std::size_t i = 0; i < m_io_service_pool.size(); ++i)
+    {
+        timing_wheel_ptr wheel(new timing_wheel(m_io_service_pool.get_io_service(i)));
+        wheel->start();
+        m_wheels.push_back(wheel);
+    }
+
+    boost::asio::ip::tcp::resolver resolver(ioservice());
     boost::asio::ip::tcp::resolver::query query(address, port);
     boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(query);
-    m_acceptor.open(endpoint.protocol());
-    m_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
-    m_acceptor.bind(endpoint);
-    m_acceptor.listen();
-    m_acceptor.async_accept(m_new_connection->socket(),
-        boost::bind(&server::handle_accept, this,
-        boost::asio::placeholders::error));
-}
 
-void server::run()
-{
-    // Create a pool of threads to run all of the io_services.
-    std::vector<boost::shared_ptr<boost::thread> > threads;
-    for (std::size_t i = 0; i < m_thread_pool_size; ++i)
+    // One acceptor per io_service with SO_REUSEPORT, otherwise a single one.
+    std::size_t count = m_options.reuse_port ? m_io_service_pool.size() : 1;
+    for (std::size_t i = 0; i < count; ++i)
     {
-        boost::shared_ptr<boost::thread> thread(new boost::thread(
-        boost::bind(&boost::asio::io_service::run, &m_io_service)));
-        threads.push_back(thread);
+        listener_ptr l(new listener(i, m_io_service_pool.get_io_service(i)));
+        open_listener(*l, endpoint);
+        m_listeners.push_back(l);
     }
 
-    // Wait for all threads in the pool to exit.
-    for (std::size_t i = 0; i < threads.size(); ++i)
-        threads[i]->join();
+    for (std::size_t i = 0; i < m_listeners.size(); ++i)
+        start_accept(m_listeners[i].get());
 }
 
-void server::run(const size_t seconds)
+void server::open_listener(listener &l, const boost::asio::ip::tcp::endpoint &endpoint)
 {
-    // Create a pool of threads to run all of the io_services.
-    std::vector<boost::shared_ptr<boost::thread> > threads;
-    for (std::size_t i = 0; i < m_thread_pool_size; ++i)
+    // Open the acceptor with the option to reuse the address (i.e. SO_REUSEADDR).
+    l.acceptor.open(endpoint.protocol());
+    l.acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+    if (m_options.reuse_port)
     {
-        boost::shared_ptr<boost::thread> thread(new boost::thread(
-        boost::bind(&boost::asio::io_service::run, &m_io_service)));
-        threads.push_back(thread);
+#ifdef SO_REUSEPORT
+        l.acceptor.set_option(reuse_port(true));
+#else
+        throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
     }
+    l.acceptor.bind(endpoint);
+    l.acceptor.listen();
+}
+
+void server::run()
+{
+    m_io_service_pool.run();
+}
 
-    boost::asio::deadline_timer timer(m_io_service);
+void server::run(const size_t seconds)
+{
+    boost::asio::deadline_timer timer(ioservice());
     timer.expires_from_now(boost::posix_time::seconds(seconds));
     timer.async_wait(boost::bind(&server::stop, this));
 
-    // Wait for all threads in the pool to exit.
-    for (std::size_t i = 0; i < threads.size(); ++i)
-        threads[i]->join();
+    m_io_service_pool.run();
 }
 
 void server::stop()
 {
-    m_io_service.stop();
+    m_io_service_pool.stop();
+}
+
+void server::start_accept(listener *l)
+{
+    // Connections accepted by a per-service acceptor stay on that service.
+    std::size_t index = m_options.reuse_port ? 
+        l->index : m_io_service_pool.next_index();
+
+    l->new_connection.reset(new connection(m_io_service_pool.get_io_service(index), 
+        m_request_handler, m_connection_list, *m_wheels[index], m_options.connection));
+    l->acceptor.async_accept(l->new_connection->socket(),
+        boost::bind(&server::handle_accept, this, l,
+        boost::asio::placeholders::error));
 }
 
-void server::handle_accept(const boost::system::error_code& e)
+void server::handle_accept(listener *l, const boost::system::error_code& e)
 {
-    if (!e)
+    if (e == boost::asio::error::operation_aborted)
+        return;
+
+    if (e)
     {
-        m_new_connection->start();
-        m_new_connection.reset(new connection(m_io_service, 
-            m_request_handler, m_connection_list));
-        m_acceptor.async_accept(m_new_connection->socket(),
-            boost::bind(&server::handle_accept, this,
+        // Failures such as EMFILE repeat until descriptors are freed: keep
+        // listening, but back off rather than spin on the acceptor.
+        std::cerr << "Accept error: " << e.message() << ", retrying in "
+            << ACCEPT_RETRY_MS << " ms" << std::endl;
+        l->retry_timer.expires_from_now(boost::posix_time::milliseconds(ACCEPT_RETRY_MS));
+        l->retry_timer.async_wait(boost::bind(&server::handle_accept_retry, this, l,
             boost::asio::placeholders::error));
+        return;
     }
+
+    m_accepted.fetch_add(1, std::memory_order_relaxed);
+    l->new_connection->start();
+    start_accept(l);
 }
 
-} // service
+void server::handle_accept_retry(listener *l, const boost::system::error_code& e)
+{
+    if (e == boost::asio::error::operation_aborted)
+        return;
 
+    start_accept(l);
+}
+
+accept_stats server::accept_statistics()
+{
+    accept_stats stats;
+    stats.accepted = m_accepted.load(std::memory_order_relaxed);
+    stats.queue_depth = 0;
+    stats.queue_limit = 0;
+
+    {
+        boost::mutex::scoped_lock lock(m_stats_mutex);
+        boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+        double seconds = (now - m_last_sample).total_microseconds() / 1e6;
+        stats.rate = seconds > 0 ? (stats.accepted - m_last_accepted) / seconds : 0;
+        m_last_accepted = stats.accepted;
+        m_last_sample = now;
+    }
+
+#ifdef __linux__
+    // For a listening socket tcpi_unacked is the current accept queue
+    // length and tcpi_sacked the backlog it was created with.
+    for (std::size_t i = 0; i < m_listeners.size(); ++i)
+    {
+        struct tcp_info info;
+        socklen_t len = sizeof(info);
+        if (getsockopt(m_listeners[i]->acceptor.native_handle(), 
+                IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+        {
+            stats.queue_depth += info.tcpi_unacked;
+            stats.queue_limit += info.tcpi_sacked;
+        }
+    }
+#endif
+
+    return stats;
+}
+
+} // service
@@ -2,20 +2,68 @@
 #define SERVER_HPP
 
 #include <boost/asio.hpp>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <list>
 
 #include "Connection.hpp"
+#include "IoServicePool.hpp"
+#include "TimingWheel.hpp"
 #include "RequestHandler.hpp"
 #include "Client.hpp"
 #include "CRedis.hpp"
 
 namespace service {
 
+/// How worker threads are mapped onto io_service objects.
+enum server_mode
+{
+    /// All threads run one shared io_service (handlers serialised by strands).
+    SHARED_IO_SERVICE,
+    /// One io_service per thread; accepted sockets are spread round-robin.
+    IO_SERVICE_PER_CORE
+};
+
+/// Tunables for server, all with usable defaults.
+struct server_options
+{
+    server_mode mode;
+    /// Pin each worker thread to a CPU (IO_SERVICE_PER_CORE only).
+    bool pin_threads;
+    /// Open one SO_REUSEPORT acceptor per io_service so the kernel spreads
+    /// incoming connections; each is served on its acceptor's io_service.
+    bool reuse_port;
+    /// Limits applied to every accepted connection.
+    connection_options connection;
+
+    server_options()
+        : mode(SHARED_IO_SERVICE),
+          pin_threads(false),
+          reuse_port(false),
+          connection()
+    {
+    }
+};
+
+/// Accept counters, summed over all acceptors.
+struct accept_stats
+{
+    /// Connections accepted since start.
+    unsigned long accepted;
+    /// Accepts per second since the previous accept_statistics() call.
+    double rate;
+    /// Connections completed by the kernel but not yet accepted.
+    std::size_t queue_depth;
+    /// Sum of the listen backlogs.
+    std::size_t queue_limit;
+};
+
 /// The top-level class of the server.
 class server : private boost::noncopyable
 {
@@ -23,9 +71,20 @@ class server : private boost::noncopyable
 public:
     /// Construct the server.
     explicit server(const std::string& address, 
-        const std::string& port, std::size_t thread_pool_size);
+        const std::string& port, std::size_t thread_pool_size,
+        const server_options &options = server_options());
+
+    /// The io_service hosting the acceptor, for auxiliary clients and timers.
+    boost::asio::io_service &ioservice() { return m_io_service_pool.get_io_service(0); }
 
-    boost::asio::io_service &ioservice() { return m_io_service; }
+    /// Live connections.
+    const connection_registry &connections() const { return m_connection_list; }
+
+    /// Command dispatch table; register handlers before run().
+    request_handler &handler() { return m_request_handler; }
+
+    /// Accept rate and pending accept queue depth.
+    accept_stats accept_statistics();
 
     /// Run the server's io_service loop.
     void run();
@@ -37,22 +96,57 @@ public:
 
 private:
 
+    /// A listening socket and the connection it is accepting into.
+    struct listener
+    {
+        explicit listener(std::size_t index, boost::asio::io_service &io_service)
+            : index(index), acceptor(io_service), retry_timer(io_service)
+        {
+        }
+
+        /// io_service the acceptor runs on.
+        std::size_t index;
+        boost::asio::ip::tcp::acceptor acceptor;
+        connection_ptr new_connection;
+        /// Delays the next accept after a failure such as EMFILE.
+        boost::asio::deadline_timer retry_timer;
+    };
+
+    typedef boost::shared_ptr<listener> listener_ptr;
+
+    /// Open, bind and listen one acceptor on endpoint.
+    void open_listener(listener &l, const boost::asio::ip::tcp::endpoint &endpoint);
+
+    /// Initiate an asynchronous accept operation on l.
+    void start_accept(listener *l);
+
     /// Handle completion of an asynchronous accept operation.
-    void handle_accept(const boost::system::error_code& e);
+    void handle_accept(listener *l, const boost::system::error_code& e);
+
+    /// Resume accepting on l once the backoff after an error has expired.
+    void handle_accept_retry(listener *l, const boost::system::error_code& e);
+
+    server_options m_options;
+
+    /// Every started connection, for admin queries. Declared before the
+    /// io_services so it outlives connections freed with their handlers.
+    connection_registry m_connection_list;
 
-    /// The number of threads that will call io_service::run().
-    std::size_t m_thread_pool_size;
+    /// The pool of io_service objects used to perform asynchronous operations.
+    io_service_pool m_io_service_pool;
 
-    /// The io_service used to perform asynchronous operations.
-    boost::asio::io_service m_io_service;
+    /// One idle/heartbeat wheel per io_service.
+    std::vector<timing_wheel_ptr> m_wheels;
 
-    /// Acceptor used to listen for incoming connections.
-    boost::asio::ip::tcp::acceptor m_acceptor;
+    /// Acceptors used to listen for incoming connections.
+    std::vector<listener_ptr> m_listeners;
 
-    connect_attr_list m_connection_list;
+    std::atomic<unsigned long> m_accepted;
 
-    /// The next connection to be accepted.
-    connection_ptr m_new_connection;
+    /// Guards the previous sample used for the accept rate.
+    boost::mutex m_stats_mutex;
+    unsigned long m_last_accepted;
+    boost::posix_time::ptime m_last_sample;
 
     /// The handler for all incoming requests.
     request_handler m_request_handler;
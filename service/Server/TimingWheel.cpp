@@ -0,0 +1,72 @@
+
+#include <algorithm>
+#include <boost/bind.hpp>
+
+#include "TimingWheel.hpp"
+
+namespace service {
+
+timing_wheel::timing_wheel(boost::asio::io_service &io_service,
+    std::size_t slots, boost::posix_time::time_duration tick) :
+    m_timer(io_service),
+    m_tick(tick),
+    m_slots(std::max<std::size_t>(slots, 2)),
+    m_cursor(0),
+    m_due()
+{
+}
+
+void timing_wheel::start()
+{
+    arm();
+}
+
+void timing_wheel::stop()
+{
+    boost::system::error_code ignored_ec;
+    m_timer.cancel(ignored_ec);
+}
+
+void timing_wheel::schedule(const boost::weak_ptr<wheel_client> &client, std::size_t ticks)
+{
+    ticks = std::min(std::max<std::size_t>(ticks, 1), m_slots.size() - 1);
+
+    boost::mutex::scoped_lock lock(m_mutex);
+    // m_cursor is the slot for the next tick, i.e. one tick away.
+    m_slots[(m_cursor + ticks - 1) % m_slots.size()].push_back(client);
+}
+
+void timing_wheel::arm()
+{
+    m_timer.expires_from_now(m_tick);
+    m_timer.async_wait(boost::bind(&timing_wheel::handle_tick, this,
+        boost::asio::placeholders::error));
+}
+
+void timing_wheel::handle_tick(const boost::system::error_code &e)
+{
+    if (e == boost::asio::error::operation_aborted)
+        return;
+
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        m_due.swap(m_slots[m_cursor]);
+        m_cursor = (m_cursor + 1) % m_slots.size();
+    }
+
+    for (slot::iterator it = m_due.begin(); it != m_due.end(); ++it)
+    {
+        boost::shared_ptr<wheel_client> client = it->lock();
+        if (!client)
+            continue;
+
+        std::size_t ticks = client->on_wheel_tick();
+        if (ticks)
+            schedule(client, ticks);
+    }
+    m_due.clear();
+
+    arm();
+}
+
+} // service
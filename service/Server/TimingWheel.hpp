@@ -0,0 +1,72 @@
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace service {
+
+/// Object visited by a timing_wheel.
+class wheel_client
+{
+public:
+    virtual ~wheel_client() {}
+
+    /// Called from the wheel's io_service when the entry's slot comes up.
+    /// Return the number of ticks until the next visit, or 0 to be dropped.
+    virtual std::size_t on_wheel_tick() = 0;
+};
+
+/// Hashed timing wheel driven by a single deadline_timer. Entries are held
+/// weakly and rescheduled lazily on each visit, so thousands of clients
+/// cost one timer and no per-activity bookkeeping.
+class timing_wheel : private boost::noncopyable
+{
+public:
+    explicit timing_wheel(boost::asio::io_service &io_service,
+        std::size_t slots = 512, 
+        boost::posix_time::time_duration tick = boost::posix_time::seconds(1));
+
+    /// Start ticking.
+    void start();
+
+    /// Stop ticking; scheduled entries are kept.
+    void stop();
+
+    /// Visit client after the given number of ticks (capped at one turn).
+    void schedule(const boost::weak_ptr<wheel_client> &client, std::size_t ticks);
+
+    boost::posix_time::time_duration tick() const { return m_tick; }
+
+private:
+    void arm();
+
+    void handle_tick(const boost::system::error_code &e);
+
+    typedef std::vector<boost::weak_ptr<wheel_client> > slot;
+
+    boost::asio::deadline_timer m_timer;
+
+    boost::posix_time::time_duration m_tick;
+
+    /// Guards m_slots and m_cursor; schedule() may run on any thread.
+    boost::mutex m_mutex;
+
+    std::vector<slot> m_slots;
+
+    /// Slot visited on the next tick.
+    std::size_t m_cursor;
+
+    /// Scratch list swapped with the due slot, kept to reuse its capacity.
+    slot m_due;
+};
+
+typedef boost::shared_ptr<timing_wheel> timing_wheel_ptr;
+
+} // service
+
+#endif // TIMING_WHEEL_HPP
@@ -32,6 +32,17 @@ distribution.
 #   include <cstdarg>
 #endif
 
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#   define TIXML_USE_MMAP
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#   if !defined(MAP_ANONYMOUS)
+#       define MAP_ANONYMOUS MAP_ANON
+#   endif
+#endif
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1400 ) && (!defined WINCE)
     // Microsoft Visual Studio, version 2005 and higher. Not WinCE.
     /*int _snprintf_s(
@@ -1831,7 +1842,9 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespace ) :
     _whitespace( whitespace ),
     _errorStr1( 0 ),
     _errorStr2( 0 ),
-    _charBuffer( 0 )
+    _charBuffer( 0 ),
+    _mappedLength( 0 ),
+    _charBufferOwned( true )
 {
     // avoid VC++ C4355 warning about 'this' in initializer list (C4355 is off by default in VS2012+)
     _document = this;
@@ -1855,8 +1868,7 @@ void XMLDocument::Clear()
     _errorStr1 = 0;
     _errorStr2 = 0;
 
-    delete [] _charBuffer;
-    _charBuffer = 0;
+    ReleaseCharBuffer();
 
 #if 0
     _textPool.Trace( "text" );
@@ -2041,6 +2053,59 @@ XMLError XMLDocument::LoadFile( FILE* fp )
 }
 
 
+XMLError XMLDocument::LoadFileMapped( const char* filename )
+{
+#ifdef TIXML_USE_MMAP
+    Clear();
+    const int fd = open( filename, O_RDONLY );
+    if ( fd < 0 ) {
+        SetError( XML_ERROR_FILE_NOT_FOUND, filename, 0 );
+        return _errorID;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode )
+         || static_cast<unsigned long long>( st.st_size ) >= static_cast<unsigned long long>( (size_t)-1 ) ) {
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    if ( st.st_size == 0 ) {
+        close( fd );
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+
+    // The parser needs a terminating null after the file: reserve one more
+    // byte of zeroed anonymous memory, then map the file over its start.
+    const size_t size = static_cast<size_t>( st.st_size );
+    const size_t length = size + 1;
+    void* base = mmap( 0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( base == MAP_FAILED ) {
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    if ( mmap( base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0 ) == MAP_FAILED ) {
+        munmap( base, length );
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    close( fd );
+
+    TIXMLASSERT( _charBuffer == 0 );
+    _charBuffer = static_cast<char*>( base );
+    _mappedLength = length;
+    _charBuffer[size] = 0;
+
+    Parse();
+    return _errorID;
+#else
+    return LoadFile( filename );
+#endif
+}
+
+
 XMLError XMLDocument::SaveFile( const char* filename, bool compact )
 {
     FILE* fp = callfopen( filename, "w" );
@@ -2081,6 +2146,32 @@ XMLError XMLDocument::Parse( const char* p, size_t len )
     memcpy( _charBuffer, p, len );
     _charBuffer[len] = 0;
 
+    return ParseCharBuffer();
+}
+
+
+XMLError XMLDocument::ParseInSitu( char* p, size_t len )
+{
+    Clear();
+
+    if ( len == 0 || !p || !*p ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+    if ( len == (size_t)(-1) ) {
+        len = strlen( p );
+    }
+    TIXMLASSERT( _charBuffer == 0 );
+    _charBuffer = p;
+    _charBufferOwned = false;
+    _charBuffer[len] = 0;
+
+    return ParseCharBuffer();
+}
+
+
+XMLError XMLDocument::ParseCharBuffer()
+{
     Parse();
     if ( Error() ) {
         // clean up now essentially dangling memory.
@@ -2146,6 +2237,21 @@ void XMLDocument::PrintError() const
     }
 }
 
+void XMLDocument::ReleaseCharBuffer()
+{
+    if ( _mappedLength ) {
+#ifdef TIXML_USE_MMAP
+        munmap( _charBuffer, _mappedLength );
+#endif
+    }
+    else if ( _charBufferOwned ) {
+        delete [] _charBuffer;
+    }
+    _charBuffer = 0;
+    _mappedLength = 0;
+    _charBufferOwned = true;
+}
+
 void XMLDocument::Parse()
 {
     TIXMLASSERT( NoChildren() ); // Clear() must have been called previously
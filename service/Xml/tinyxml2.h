@@ -1611,6 +1611,21 @@ public:
     */
     XMLError Parse( const char* xml, size_t nBytes=(size_t)(-1) );
 
+    /**
+        Parse an XML document in place, from a buffer you own,
+        instead of copying it first. Returns XML_NO_ERROR (0) on
+        success, or an errorID.
+
+        The buffer is modified by parsing and the nodes point into
+        it, so it must stay valid, and must not be changed, until
+        the document is cleared or parses again.
+
+        If 'nBytes' is specified, xml[nBytes] must be writable:
+        the terminating null is written there. Otherwise 'xml'
+        must be null terminated.
+    */
+    XMLError ParseInSitu( char* xml, size_t nBytes=(size_t)(-1) );
+
     /**
         Load an XML file from disk.
         Returns XML_NO_ERROR (0) on success, or
@@ -1631,6 +1646,20 @@ public:
     */
     XMLError LoadFile( FILE* );
 
+    /**
+        Load an XML file from disk by mapping it into memory and
+        parsing it in place, so it is not copied into a buffer.
+        The mapping is private: the file itself is not changed. It
+        is released when the document is cleared. The file must
+        not be truncated while the document is in use.
+
+        Where files cannot be mapped, this is LoadFile().
+
+        Returns XML_NO_ERROR (0) on success, or
+        an errorID.
+    */
+    XMLError LoadFileMapped( const char* filename );
+
     /**
         Save the XML file to disk.
         Returns XML_NO_ERROR (0) on success, or
@@ -1783,6 +1812,8 @@ private:
     const char* _errorStr1;
     const char* _errorStr2;
     char*       _charBuffer;
+    size_t      _mappedLength;      // of _charBuffer, if LoadFileMapped() mapped it
+    bool        _charBufferOwned;   // false after ParseInSitu()
 
     MemPoolT< sizeof(XMLElement) >   _elementPool;
     MemPoolT< sizeof(XMLAttribute) > _attributePool;
@@ -1792,6 +1823,8 @@ private:
     static const char* _errorNames[XML_ERROR_COUNT];
 
     void Parse();
+    XMLError ParseCharBuffer();
+    void ReleaseCharBuffer();
 };
 
 